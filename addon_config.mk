@@ -24,7 +24,8 @@ meta:
 common:
 	# dependencies with other addons, a list of them separated by spaces 
 	# or use += in several lines
-	# ADDON_DEPENDENCIES =
+	# ofxNetwork carries the state mirror, see startMirrorSender()
+	ADDON_DEPENDENCIES = ofxNetwork
 	
 	# include search paths, this will be usually parsed from the file system
 	# but if the addon or addon libraries need special search paths they can be
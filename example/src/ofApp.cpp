@@ -90,6 +90,9 @@ void ofApp::draw() {
 			"  /__/     /_____/    poniesandlight.co.uk\n\n"
 			"<i> toggle info text | <a|b> toggle parameter group", 10, ofGetHeight() - 12 * 7);
 
+		// what the twister cost over the last frame - compile with 
+		// OFX_PARAMETER_TWISTER_PROFILE=1 to have this filled in.
+		ofDrawBitmapStringHighlight(mTwister.getFrameReport().toString(), ofGetWidth() - 370, 20);
 	}
 	mPanel1.draw();
 }
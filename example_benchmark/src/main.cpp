@@ -0,0 +1,326 @@
+#include "ofMain.h"
+#include "ofxParameterTwister.h"
+#include "RtMidi.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <thread>
+
+// headless benchmark for ofxParameterTwister.
+//
+// instead of a twister, we open a pair of virtual midi ports, which the
+// addon finds, and opens, as if they were a twister: whatever we send
+// on our virtual output is what the addon receives, and whatever the
+// addon sends arrives at our virtual input.
+//
+// virtual ports need CoreMIDI (macOS) or ALSA (linux) - WinMM has none.
+// ALSA names ports after their client, so both clients carry the name
+// the addon looks for.
+//
+// usage:
+//   example_benchmark                      run, and print results
+//   example_benchmark --save <file>        ... and write them to file
+//   example_benchmark --baseline <file>    ... and fail if any result is
+//                                          more than 25% worse than file
+
+using namespace pal::Kontrol;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const std::string PORT_NAME = "Midi Fighter Twister Benchmark";
+
+// ------------------------------------------------------
+
+double elapsed_us(Clock::time_point since_) {
+	return std::chrono::duration<double, std::micro>(Clock::now() - since_).count();
+}
+
+// ------------------------------------------------------
+
+/// counts what the addon sends to the "device".
+struct OutputCounter {
+	std::atomic<uint64_t> messages{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
+
+	static void callback(double, std::vector<unsigned char>* message_, void* self_) {
+		auto self = static_cast<OutputCounter*>(self_);
+		// several messages written in one go may arrive as one event
+		self->messages += (message_->size() + 2) / 3;
+		self->bytes += message_->size();
+	}
+
+	void reset() {
+		messages = 0;
+		bytes = 0;
+	}
+};
+
+// ------------------------------------------------------
+
+/// results by name - all of them are "lower is better".
+typedef std::map<std::string, double> Results;
+
+void printResult(Results& results_, const std::string& name_, double value_, const char* unit_) {
+	results_[name_] = value_;
+	printf("  %-36s %12.2f %s\n", name_.c_str(), value_, unit_);
+}
+
+// ------------------------------------------------------
+
+/// lets midi in flight settle, whilst keeping the addon's queues drained.
+void settle(ofxParameterTwister& twister_, int ms_) {
+	auto until = Clock::now() + std::chrono::milliseconds(ms_);
+	while (Clock::now() < until) {
+		twister_.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// ------------------------------------------------------
+
+void benchmarkInput(ofxParameterTwister& twister_, RtMidiOut& device_, Results& results_) {
+
+	static const size_t NUM_MESSAGES = 20000;
+	static const size_t BURST = 128; ///< well below the input queue capacity
+
+	std::vector<ofParameter<float>> params(16);
+	ofParameterGroup group;
+	for (size_t i = 0; i < params.size(); ++i) {
+		params[i].set("p" + ofToString(i), 0.f, 0.f, 1.f);
+		group.add(params[i]);
+	}
+	twister_.setParams(group);
+	settle(twister_, 100);
+	twister_.resetStats();
+
+	std::vector<unsigned char> msg(3);
+	auto start = Clock::now();
+
+	for (size_t sent = 0; sent < NUM_MESSAGES;) {
+		for (size_t i = 0; i < BURST && sent < NUM_MESSAGES; ++i, ++sent) {
+			msg[0] = 0xB0;
+			msg[1] = uint8_t(sent % 16);
+			msg[2] = uint8_t(sent % 128);
+			device_.sendMessage(&msg);
+		}
+		twister_.update();
+	}
+
+	// wait for stragglers
+	auto deadline = Clock::now() + std::chrono::seconds(2);
+	while (twister_.getStats().messagesIn < NUM_MESSAGES && Clock::now() < deadline) {
+		twister_.update();
+	}
+
+	double total_us = elapsed_us(start);
+	auto stats = twister_.getStats();
+
+	printf("input: %zu rotary messages, in bursts of %zu\n", NUM_MESSAGES, BURST);
+	printResult(results_, "input.time_per_message", total_us / NUM_MESSAGES, "us");
+	printResult(results_, "input.latency_p50", stats.latencyP50_us, "us");
+	printResult(results_, "input.latency_p99", stats.latencyP99_us, "us");
+	printResult(results_, "input.lost", double(NUM_MESSAGES - std::min<uint64_t>(stats.messagesIn, NUM_MESSAGES)), "messages");
+}
+
+// ------------------------------------------------------
+
+void benchmarkPageSwitch(ofxParameterTwister& twister_, size_t numParams_, Results& results_) {
+
+	static const size_t NUM_SWITCHES = 1000;
+
+	// two pages, so that every switch changes all encoders. floats
+	// and bools, so that encoders change state, too.
+	std::vector<ofParameter<float>> floats(numParams_);
+	std::vector<ofParameter<bool>> bools(numParams_);
+	ofParameterGroup groupA, groupB;
+	for (size_t i = 0; i < numParams_; ++i) {
+		floats[i].set("f" + ofToString(i), float(i) / numParams_, 0.f, 1.f);
+		bools[i].set("b" + ofToString(i), i % 2 == 0);
+		groupA.add(floats[i]);
+		groupB.add(bools[i]);
+	}
+
+	std::string prefix = "page_switch_" + ofToString(numParams_) + ".";
+
+	// first use of a group prepares its bindings - later uses hit the page cache
+	auto start = Clock::now();
+	twister_.setParams(groupA);
+	twister_.setParams(groupB);
+	double cold_us = elapsed_us(start) / 2;
+
+	double setParams_us = 0.0;
+	double update_us = 0.0;
+
+	for (size_t i = 0; i < NUM_SWITCHES; ++i) {
+		start = Clock::now();
+		twister_.setParams(i % 2 == 0 ? groupA : groupB);
+		setParams_us += elapsed_us(start);
+
+		// the cost of a switch includes queueing, and sending, what changed
+		start = Clock::now();
+		twister_.update();
+		update_us += elapsed_us(start);
+	}
+
+	printf("page switch: %zu parameters, %zu switches\n", numParams_, NUM_SWITCHES);
+	printResult(results_, prefix + "first_use", cold_us, "us");
+	printResult(results_, prefix + "setParams", setParams_us / NUM_SWITCHES, "us");
+	printResult(results_, prefix + "update", update_us / NUM_SWITCHES, "us");
+
+	settle(twister_, 100);
+}
+
+// ------------------------------------------------------
+
+void benchmarkOutput(ofxParameterTwister& twister_, OutputCounter& counter_, Results& results_) {
+
+	static const size_t NUM_FRAMES = 600;
+
+	// all 64 encoders, every parameter changes every frame
+	std::vector<ofParameter<float>> params(ofxParameterTwister::NUM_ENCODERS);
+	ofParameterGroup group;
+	for (size_t i = 0; i < params.size(); ++i) {
+		params[i].set("p" + ofToString(i), 0.f, 0.f, 1.f);
+		group.add(params[i]);
+	}
+	twister_.setParams(group);
+	settle(twister_, 200);
+	counter_.reset();
+	twister_.resetStats();
+
+	double update_us = 0.0;
+
+	for (size_t frame = 0; frame < NUM_FRAMES; ++frame) {
+		for (size_t i = 0; i < params.size(); ++i) {
+			params[i] = 0.5f + 0.5f * std::sin(frame * 0.05f + i * 0.1f);
+		}
+		auto start = Clock::now();
+		twister_.update();
+		update_us += elapsed_us(start);
+		// roughly 60 frames per second, so that rate limits see real timing
+		std::this_thread::sleep_for(std::chrono::microseconds(16667));
+	}
+
+	settle(twister_, 200);
+
+	printf("output: %zu parameters animated, %zu frames\n", params.size(), NUM_FRAMES);
+	printResult(results_, "output.update", update_us / NUM_FRAMES, "us");
+	printResult(results_, "output.messages_per_frame", double(twister_.getStats().messagesOut) / NUM_FRAMES, "messages");
+	printResult(results_, "output.bytes_per_frame", double(counter_.bytes) / NUM_FRAMES, "bytes");
+}
+
+// ------------------------------------------------------
+
+bool saveResults(const Results& results_, const std::string& path_) {
+	std::ofstream file(path_);
+	for (auto & r : results_) {
+		file << r.first << " " << r.second << "\n";
+	}
+	return bool(file);
+}
+
+// ------------------------------------------------------
+
+/// returns false if any result is more than tolerance_ worse than baseline.
+bool compareResults(const Results& results_, const std::string& path_, double tolerance_) {
+	std::ifstream file(path_);
+	if (!file) {
+		printf("could not read baseline '%s'\n", path_.c_str());
+		return false;
+	}
+
+	bool passed = true;
+	std::string name;
+	double baseline;
+
+	while (file >> name >> baseline) {
+		auto it = results_.find(name);
+		if (it == results_.end()) {
+			continue;
+		}
+		// small absolute slack, so that results close to zero don't
+		// fail on noise.
+		if (it->second > baseline * (1.0 + tolerance_) + 1.0) {
+			printf("REGRESSION %-36s %12.2f, baseline %.2f\n", name.c_str(), it->second, baseline);
+			passed = false;
+		}
+	}
+
+	return passed;
+}
+
+} // anonymous namespace
+
+//========================================================================
+int main(int argc, char* argv[]) {
+
+	std::string savePath;
+	std::string baselinePath;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--save") {
+			savePath = argv[i + 1];
+		} else if (arg == "--baseline") {
+			baselinePath = argv[i + 1];
+		}
+	}
+
+	// ----------| set up the virtual twister
+
+	RtMidiOut device(RtMidi::UNSPECIFIED, PORT_NAME);
+	RtMidiIn deviceIn(RtMidi::UNSPECIFIED, PORT_NAME);
+	OutputCounter counter;
+
+	try {
+		device.openVirtualPort(PORT_NAME);
+		deviceIn.setCallback(&OutputCounter::callback, &counter);
+		deviceIn.openVirtualPort(PORT_NAME);
+	} catch (RtMidiError& error) {
+		std::cout << "MIDI virtual port exception:" << std::endl;
+		error.printMessage();
+		std::cout << "this benchmark needs virtual midi ports, i.e. CoreMIDI, or ALSA." << std::endl;
+		return 2;
+	}
+
+	ofxParameterTwister twister;
+	ofxParameterTwister::Settings settings;
+	settings.portName = PORT_NAME;
+	settings.openDevicesInBackground = false;	// we want the ports open once setup() returns
+	settings.watchdogIntervalSeconds = 0.f;		// and nothing scanning ports whilst we measure
+	settings.inputQueueCapacity = 1024;
+	twister.setup(settings);
+
+	if (!twister.isConnected(0)) {
+		printf("the addon did not find our virtual port '%s'\n", PORT_NAME.c_str());
+		return 2;
+	}
+
+	// ----------| invariant: addon is connected to our virtual twister
+
+	Results results;
+
+	benchmarkInput(twister, device, results);
+	benchmarkPageSwitch(twister, 16, results);
+	benchmarkPageSwitch(twister, 64, results);
+	benchmarkOutput(twister, counter, results);
+
+	if (!savePath.empty() && !saveResults(results, savePath)) {
+		printf("could not write results to '%s'\n", savePath.c_str());
+	}
+
+	if (!baselinePath.empty()) {
+		if (!compareResults(results, baselinePath, 0.25)) {
+			return 1;
+		}
+		printf("no regressions against '%s'\n", baselinePath.c_str());
+	}
+
+	return 0;
+}
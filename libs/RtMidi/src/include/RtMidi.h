@@ -214,6 +214,9 @@ class RtMidiIn : public RtMidi
   //! User callback function type definition.
   typedef void (*RtMidiCallback)( double timeStamp, std::vector<unsigned char> *message, void *userData);
 
+  //! Short message callback function type definition, for 3 byte channel voice messages.
+  typedef void (*RtMidiShortCallback)( double timeStamp, unsigned char status, unsigned char data1, unsigned char data2, void *userData );
+
   //! Default constructor that allows an optional api, client name and queue size.
   /*!
     An exception will be thrown if a MIDI system initialization
@@ -282,6 +285,23 @@ class RtMidiIn : public RtMidi
   */
   void cancelCallback();
 
+  //! Set a callback function to be invoked for incoming 3 byte channel voice messages.
+  /*!
+    Note off, note on, polyphonic pressure, control change and pitch
+    bend messages are passed to this callback as single bytes, without
+    being copied into a message vector first.  All other messages are
+    passed to the callback set with setCallback() - or, if no such
+    callback is set, dropped: they are not written to the queue.
+
+    \param callback A callback function must be given.
+    \param userData Optionally, a pointer to additional data can be
+                    passed to the callback function whenever it is called.
+  */
+  void setShortCallback( RtMidiShortCallback callback, void *userData = 0 );
+
+  //! Cancel use of the current short message callback function (if one exists).
+  void cancelShortCallback();
+
   //! Close an open MIDI connection (if one exists).
   void closePort( void );
 
@@ -412,6 +432,14 @@ class RtMidiOut : public RtMidi
   */
   void sendMessage( std::vector<unsigned char> *message );
 
+  //! Immediately send a single 3 byte channel voice message out an open MIDI output port.
+  /*!
+      Same as sendMessage(), but without the message vector.  status
+      must be the status byte of a note off, note on, polyphonic
+      pressure, control change or pitch bend message.
+  */
+  void sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -474,9 +502,18 @@ class MidiInApi : public MidiApi
   virtual ~MidiInApi( void );
   void setCallback( RtMidiIn::RtMidiCallback callback, void *userData );
   void cancelCallback( void );
+  void setShortCallback( RtMidiIn::RtMidiShortCallback callback, void *userData );
+  void cancelShortCallback( void );
   virtual void ignoreTypes( bool midiSysex, bool midiTime, bool midiSense );
   double getMessage( std::vector<unsigned char> *message );
 
+  // Returns true if status starts a 3 byte channel voice message:
+  // note off, note on, polyphonic pressure, control change or pitch bend.
+  static bool isShortMessage( unsigned char status )
+  {
+    return ( status >= 0x80 && status < 0xC0 ) || ( status >= 0xE0 && status < 0xF0 );
+  }
+
   // A MIDI structure used internally by the class to store incoming
   // messages.  Each message represents one and only one MIDI message.
   struct MidiMessage { 
@@ -512,13 +549,15 @@ class MidiInApi : public MidiApi
     bool usingCallback;
     RtMidiIn::RtMidiCallback userCallback;
     void *userData;
+    RtMidiIn::RtMidiShortCallback shortCallback;
+    void *shortUserData;
     bool continueSysex;
 
     // Default constructor.
   RtMidiInData()
   : ignoreFlags(7), doInput(false), firstMessage(true),
       apiData(0), usingCallback(false), userCallback(0), userData(0),
-      continueSysex(false) {}
+      shortCallback(0), shortUserData(0), continueSysex(false) {}
   };
 
  protected:
@@ -532,6 +571,7 @@ class MidiOutApi : public MidiApi
   MidiOutApi( void );
   virtual ~MidiOutApi( void );
   virtual void sendMessage( std::vector<unsigned char> *message ) = 0;
+  virtual void sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 );
 };
 
 // **************************************************************** //
@@ -547,6 +587,8 @@ inline void RtMidiIn :: closePort( void ) { rtapi_->closePort(); }
 inline bool RtMidiIn :: isPortOpen() const { return rtapi_->isPortOpen(); }
 inline void RtMidiIn :: setCallback( RtMidiCallback callback, void *userData ) { ((MidiInApi *)rtapi_)->setCallback( callback, userData ); }
 inline void RtMidiIn :: cancelCallback( void ) { ((MidiInApi *)rtapi_)->cancelCallback(); }
+inline void RtMidiIn :: setShortCallback( RtMidiShortCallback callback, void *userData ) { ((MidiInApi *)rtapi_)->setShortCallback( callback, userData ); }
+inline void RtMidiIn :: cancelShortCallback( void ) { ((MidiInApi *)rtapi_)->cancelShortCallback(); }
 inline unsigned int RtMidiIn :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiIn :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiIn :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense ) { ((MidiInApi *)rtapi_)->ignoreTypes( midiSysex, midiTime, midiSense ); }
@@ -561,6 +603,7 @@ inline bool RtMidiOut :: isPortOpen() const { return rtapi_->isPortOpen(); }
 inline unsigned int RtMidiOut :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiOut :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiOut :: sendMessage( std::vector<unsigned char> *message ) { ((MidiOutApi *)rtapi_)->sendMessage( message ); }
+inline void RtMidiOut :: sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 ) { ((MidiOutApi *)rtapi_)->sendShortMessage( status, data1, data2 ); }
 inline void RtMidiOut :: setErrorCallback( RtMidiErrorCallback errorCallback ) { rtapi_->setErrorCallback(errorCallback); }
 
 // **************************************************************** //
@@ -603,6 +646,7 @@ class MidiOutCore: public MidiOutApi
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( std::vector<unsigned char> *message );
+  void sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 );
 
  protected:
   void initialize( const std::string& clientName );
@@ -683,6 +727,7 @@ class MidiOutAlsa: public MidiOutApi
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( std::vector<unsigned char> *message );
+  void sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 );
 
  protected:
   void initialize( const std::string& clientName );
@@ -720,6 +765,7 @@ class MidiOutWinMM: public MidiOutApi
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( std::vector<unsigned char> *message );
+  void sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 );
 
  protected:
   void initialize( const std::string& clientName );
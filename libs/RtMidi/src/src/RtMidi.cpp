@@ -318,6 +318,49 @@ void MidiInApi :: cancelCallback()
   inputData_.usingCallback = false;
 }
 
+void MidiInApi :: setShortCallback( RtMidiIn::RtMidiShortCallback callback, void *userData )
+{
+  if ( inputData_.shortCallback ) {
+    errorString_ = "MidiInApi::setShortCallback: a short message callback function is already set!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  if ( !callback ) {
+    errorString_ = "RtMidiIn::setShortCallback: callback function value is invalid!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  inputData_.shortUserData = userData;
+  inputData_.shortCallback = callback;
+}
+
+void MidiInApi :: cancelShortCallback()
+{
+  if ( !inputData_.shortCallback ) {
+    errorString_ = "RtMidiIn::cancelShortCallback: no short message callback function was set!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  inputData_.shortCallback = 0;
+  inputData_.shortUserData = 0;
+}
+
+// Passes a 3 byte channel voice message straight to the short message
+// callback, if one is set.  Returns false if the message has to take
+// the usual path, through the message vector.  With a short message
+// callback, but no callback for the message vector, all other messages
+// are dropped rather than queued, as nobody would read the queue.
+static inline bool dispatchShortMessage( MidiInApi::RtMidiInData *data, double timeStamp,
+                                         const unsigned char *bytes, unsigned int nBytes )
+{
+  if ( !data->shortCallback || nBytes != 3 || !MidiInApi::isShortMessage( bytes[0] ) ) return false;
+  data->shortCallback( timeStamp, bytes[0], bytes[1], bytes[2], data->shortUserData );
+  return true;
+}
+
 void MidiInApi :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense )
 {
   inputData_.ignoreFlags = 0;
@@ -363,6 +406,16 @@ MidiOutApi :: ~MidiOutApi( void )
 {
 }
 
+void MidiOutApi :: sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 )
+{
+  // APIs without a short message path of their own go through sendMessage().
+  std::vector<unsigned char> message( 3 );
+  message[0] = status;
+  message[1] = data1;
+  message[2] = data2;
+  sendMessage( &message );
+}
+
 // *************************************************** //
 //
 // OS/API-specific methods.
@@ -461,7 +514,7 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
           RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
           callback( message.timeStamp, &message.bytes, data->userData );
         }
-        else {
+        else if ( !data->shortCallback ) {
           // As long as we haven't reached our queue size limit, push the message.
           if ( data->queue.size < data->queue.ringSize ) {
             data->queue.ring[data->queue.back++] = message;
@@ -516,6 +569,12 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
         }
         else size = 1;
 
+        // Channel voice messages may skip the vector.
+        if ( size && !continueSysex && dispatchShortMessage( data, message.timeStamp, &packet->data[iByte], size ) ) {
+          iByte += size;
+          continue;
+        }
+
         // Copy the MIDI data to our vector.
         if ( size ) {
           message.bytes.assign( &packet->data[iByte], &packet->data[iByte+size] );
@@ -525,7 +584,7 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
               RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
               callback( message.timeStamp, &message.bytes, data->userData );
             }
-            else {
+            else if ( !data->shortCallback ) {
               // As long as we haven't reached our queue size limit, push the message.
               if ( data->queue.size < data->queue.ringSize ) {
                 data->queue.ring[data->queue.back++] = message;
@@ -1077,6 +1136,40 @@ void MidiOutCore :: sendMessage( std::vector<unsigned char> *message )
   }
 }
 
+void MidiOutCore :: sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 )
+{
+  const Byte bytes[3] = { status, data1, data2 };
+  CoreMidiData *data = static_cast<CoreMidiData *> (apiData_);
+  OSStatus result;
+
+  MIDIPacketList packetList;
+  MIDIPacket *packet = MIDIPacketListInit( &packetList );
+  packet = MIDIPacketListAdd( &packetList, sizeof(packetList), packet, AudioGetCurrentHostTime(), 3, bytes );
+  if ( !packet ) {
+    errorString_ = "MidiOutCore::sendShortMessage: could not allocate packet list";
+    error( RtMidiError::DRIVER_ERROR, errorString_ );
+    return;
+  }
+
+  // Send to any destinations that may have connected to us.
+  if ( data->endpoint ) {
+    result = MIDIReceived( data->endpoint, &packetList );
+    if ( result != noErr ) {
+      errorString_ = "MidiOutCore::sendShortMessage: error sending MIDI to virtual destinations.";
+      error( RtMidiError::WARNING, errorString_ );
+    }
+  }
+
+  // And send to an explicit destination port if we're connected.
+  if ( connected_ ) {
+    result = MIDISend( data->port, data->destinationId, &packetList );
+    if ( result != noErr ) {
+      errorString_ = "MidiOutCore::sendShortMessage: error sending MIDI message to port.";
+      error( RtMidiError::WARNING, errorString_ );
+    }
+  }
+}
+
 #endif  // __MACOSX_CORE__
 
 
@@ -1138,6 +1231,7 @@ static void *alsaMidiHandler( void *ptr )
   unsigned long long time, lastTime;
   bool continueSysex = false;
   bool doDecode = false;
+  bool isShort = false;
   MidiInApi::MidiMessage message;
   int poll_fd_count;
   struct pollfd *poll_fds;
@@ -1199,6 +1293,7 @@ static void *alsaMidiHandler( void *ptr )
     if ( !continueSysex ) message.bytes.clear();
 
     doDecode = false;
+    isShort = false;
     switch ( ev->type ) {
 
     case SND_SEQ_EVENT_PORT_SUBSCRIBED:
@@ -1260,12 +1355,16 @@ static void *alsaMidiHandler( void *ptr )
         // than this, they are segmented into 256 byte chunks.  So,
         // we'll watch for this and concatenate sysex chunks into a
         // single sysex message if necessary.
-        if ( !continueSysex )
-          message.bytes.assign( buffer, &buffer[nBytes] );
-        else
-          message.bytes.insert( message.bytes.end(), buffer, &buffer[nBytes] );
+        // Channel voice messages may skip the vector: their bytes stay in our buffer.
+        isShort = !continueSysex && data->shortCallback && nBytes == 3 && MidiInApi::isShortMessage( buffer[0] );
+        if ( !isShort ) {
+          if ( !continueSysex )
+            message.bytes.assign( buffer, &buffer[nBytes] );
+          else
+            message.bytes.insert( message.bytes.end(), buffer, &buffer[nBytes] );
+        }
 
-        continueSysex = ( ( ev->type == SND_SEQ_EVENT_SYSEX ) && ( message.bytes.back() != 0xF7 ) );
+        continueSysex = !isShort && ( ev->type == SND_SEQ_EVENT_SYSEX ) && ( message.bytes.back() != 0xF7 );
         if ( !continueSysex ) {
 
           // Calculate the time stamp:
@@ -1295,13 +1394,17 @@ static void *alsaMidiHandler( void *ptr )
     }
 
     snd_seq_free_event( ev );
+    if ( isShort ) {
+      data->shortCallback( message.timeStamp, buffer[0], buffer[1], buffer[2], data->shortUserData );
+      continue;
+    }
     if ( message.bytes.size() == 0 || continueSysex ) continue;
 
     if ( data->usingCallback ) {
       RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
       callback( message.timeStamp, &message.bytes, data->userData );
     }
-    else {
+    else if ( !data->shortCallback ) {
       // As long as we haven't reached our queue size limit, push the message.
       if ( data->queue.size < data->queue.ringSize ) {
         data->queue.ring[data->queue.back++] = message;
@@ -1899,6 +2002,34 @@ void MidiOutAlsa :: sendMessage( std::vector<unsigned char> *message )
   snd_seq_drain_output(data->seq);
 }
 
+void MidiOutAlsa :: sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 )
+{
+  int result;
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  unsigned char bytes[3] = { status, data1, data2 };
+
+  snd_seq_event_t ev;
+  snd_seq_ev_clear(&ev);
+  snd_seq_ev_set_source(&ev, data->vport);
+  snd_seq_ev_set_subs(&ev);
+  snd_seq_ev_set_direct(&ev);
+  result = snd_midi_event_encode( data->coder, bytes, 3, &ev );
+  if ( result < 3 ) {
+    errorString_ = "MidiOutAlsa::sendShortMessage: event parsing error!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  // Send the event.
+  result = snd_seq_event_output(data->seq, &ev);
+  if ( result < 0 ) {
+    errorString_ = "MidiOutAlsa::sendShortMessage: error sending MIDI message to port.";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+  snd_seq_drain_output(data->seq);
+}
+
 #endif // __LINUX_ALSA__
 
 
@@ -1986,8 +2117,11 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
       return;
     }
 
-    // Copy bytes to our MIDI message.
+    // Channel voice messages may skip the vector.
     unsigned char *ptr = (unsigned char *) &midiMessage;
+    if ( dispatchShortMessage( data, apiData->message.timeStamp, ptr, nBytes ) ) return;
+
+    // Copy bytes to our MIDI message.
     for ( int i=0; i<nBytes; ++i ) apiData->message.bytes.push_back( *ptr++ );
   }
   else { // Sysex message ( MIM_LONGDATA or MIM_LONGERROR )
@@ -2023,7 +2157,7 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
     RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
     callback( apiData->message.timeStamp, &apiData->message.bytes, data->userData );
   }
-  else {
+  else if ( !data->shortCallback ) {
     // As long as we haven't reached our queue size limit, push the message.
     if ( data->queue.size < data->queue.ringSize ) {
       data->queue.ring[data->queue.back++] = apiData->message;
@@ -2421,6 +2555,21 @@ void MidiOutWinMM :: sendMessage( std::vector<unsigned char> *message )
   }
 }
 
+void MidiOutWinMM :: sendShortMessage( unsigned char status, unsigned char data1, unsigned char data2 )
+{
+  if ( !connected_ ) return;
+
+  WinMidiData *data = static_cast<WinMidiData *> (apiData_);
+
+  // Pack MIDI bytes into double word, and send the message immediately.
+  DWORD packet = (DWORD) status | ( (DWORD) data1 << 8 ) | ( (DWORD) data2 << 16 );
+  MMRESULT result = midiOutShortMsg( data->outHandle, packet );
+  if ( result != MMSYSERR_NOERROR ) {
+    errorString_ = "MidiOutWinMM::sendShortMessage: error sending MIDI message.";
+    error( RtMidiError::DRIVER_ERROR, errorString_ );
+  }
+}
+
 #endif  // __WINDOWS_MM__
 
 
@@ -2474,9 +2623,6 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
 
     jack_midi_event_get( &event, buff, j );
 
-    for ( unsigned int i = 0; i < event.size; i++ )
-      message.bytes.push_back( event.buffer[i] );
-
     // Compute the delta time.
     time = jack_get_time();
     if ( rtData->firstMessage == true )
@@ -2486,12 +2632,18 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
 
     jData->lastTime = time;
 
+    // Channel voice messages may skip the vector.
+    if ( !rtData->continueSysex && dispatchShortMessage( rtData, message.timeStamp, event.buffer, (unsigned int) event.size ) ) continue;
+
+    for ( unsigned int i = 0; i < event.size; i++ )
+      message.bytes.push_back( event.buffer[i] );
+
     if ( !rtData->continueSysex ) {
       if ( rtData->usingCallback ) {
         RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) rtData->userCallback;
         callback( message.timeStamp, &message.bytes, rtData->userData );
       }
-      else {
+      else if ( !rtData->shortCallback ) {
         // As long as we haven't reached our queue size limit, push the message.
         if ( rtData->queue.size < rtData->queue.ringSize ) {
           rtData->queue.ring[rtData->queue.back++] = message;
@@ -0,0 +1,74 @@
+#include "FrameProfiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace pal::Kontrol;
+
+// ------------------------------------------------------
+
+const char * FrameReport::getName(ProfileScope s_) {
+	switch (s_) {
+	case ProfileScope::UPDATE:				return "update";
+	case ProfileScope::MIDI_CALLBACK:		return "midi callback";
+	case ProfileScope::INPUT_DRAIN:			return "input drain";
+	case ProfileScope::SET_PARAMS:			return "setParams";
+	case ProfileScope::ENCODER_SEND:		return "encoder send";
+	case ProfileScope::LISTENER_DISPATCH:	return "listener dispatch";
+	default:								return "";
+	}
+}
+
+// ------------------------------------------------------
+
+std::string FrameReport::toString() const {
+
+	if (!isCompiledIn) {
+		return "profiling not compiled in, see OFX_PARAMETER_TWISTER_PROFILE";
+	}
+
+	// ----------| invariant: counters hold a full frame
+
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(3);
+	s << "frame " << std::setw(8) << frameTime_ns * 1e-6 << " ms, midi out " << midiBytesSent << " bytes\n";
+	s << std::left << std::setw(18) << "scope" << std::right
+		<< std::setw(8) << "calls"
+		<< std::setw(10) << "total ms"
+		<< std::setw(10) << "max ms" << "\n";
+
+	for (size_t i = 0; i < scopes.size(); ++i) {
+		const auto & sc = scopes[i];
+		s << std::left << std::setw(18) << getName(ProfileScope(i)) << std::right
+			<< std::setw(8) << sc.calls
+			<< std::setw(10) << sc.total_ns * 1e-6
+			<< std::setw(10) << sc.max_ns * 1e-6 << "\n";
+	}
+
+	return s.str();
+}
+
+// ------------------------------------------------------
+
+void FrameProfiler::endFrame(uint64_t sentMessages_) {
+
+	const uint64_t now = now_ns();
+
+	for (size_t i = 0; i < mCounters.size(); ++i) {
+		auto & c = mCounters[i];
+		auto & r = mLastFrame.scopes[i];
+		// a scope which closes between these exchanges lands
+		// partly in this frame, and partly in the next one.
+		r.calls = c.calls.exchange(0, std::memory_order_relaxed);
+		r.total_ns = c.total_ns.exchange(0, std::memory_order_relaxed);
+		r.max_ns = c.max_ns.exchange(0, std::memory_order_relaxed);
+	}
+
+	// every message we send is a 3 byte CC message
+	mLastFrame.midiBytesSent = 3 * (sentMessages_ - mSentAtFrameStart);
+	mLastFrame.frameTime_ns = (mFrameStart_ns != 0) ? now - mFrameStart_ns : 0;
+	mLastFrame.isCompiledIn = COMPILED_IN;
+
+	mSentAtFrameStart = sentMessages_;
+	mFrameStart_ns = now;
+}
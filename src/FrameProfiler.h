@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// set this to 1 (e.g. via ADDON_CFLAGS = -DOFX_PARAMETER_TWISTER_PROFILE=1)
+// to compile in profiling scopes. when 0, scopes are empty, and all
+// profiling code is compiled out of the midi hot paths.
+#ifndef OFX_PARAMETER_TWISTER_PROFILE
+#	define OFX_PARAMETER_TWISTER_PROFILE 0
+#endif
+
+namespace pal {
+namespace Kontrol {
+
+/// hot paths which may be profiled. scopes nest - time spent
+/// sending to encoders from a listener counts towards both.
+enum class ProfileScope : uint8_t {
+	UPDATE = 0,			///< all of update()
+	MIDI_CALLBACK,		///< one midi message, on the midi driver thread
+	INPUT_DRAIN,		///< update() applying the midi input which arrived since the last frame
+	SET_PARAMS,			///< setParams()
+	ENCODER_SEND,		///< an encoder staging a value for its device
+	LISTENER_DISPATCH,	///< a parameter listener forwarding a change to its encoder
+	COUNT,
+};
+
+// ------------------------------------------------------
+/// \brief		what the profiled scopes cost over one frame
+/// \detail		a frame runs from the start of one update() to the start
+/// of the next one - so the report covers the previous frame in full.
+struct FrameReport {
+
+	struct Scope {
+		uint64_t calls = 0;
+		uint64_t total_ns = 0;
+		uint64_t max_ns = 0;	///< longest single call
+	};
+
+	std::array<Scope, size_t(ProfileScope::COUNT)> scopes;
+	uint64_t midiBytesSent = 0;	///< written to all midi out ports over the frame
+	uint64_t frameTime_ns = 0;	///< time between the two update() calls which bound the frame
+	bool isCompiledIn = false;	///< all counters stay zero unless profiling is compiled in
+
+	const Scope& operator[](ProfileScope s_) const {
+		return scopes[size_t(s_)];
+	};
+
+	static const char* getName(ProfileScope s_);
+
+	/// one line per scope, in milliseconds - meant to be drawn
+	/// with ofDrawBitmapString().
+	std::string toString() const;
+};
+
+// ------------------------------------------------------
+/// \brief		per-frame counters for profiling scopes
+/// \detail		scopes may close on any thread - midi callbacks close
+/// theirs on midi driver threads - so counters are relaxed atomics:
+/// adding a sample never blocks, or allocates. endFrame() is called
+/// from update(), and swaps the counters into the report for the
+/// frame which has just ended.
+class FrameProfiler {
+public:
+
+	static const bool COMPILED_IN = (OFX_PARAMETER_TWISTER_PROFILE != 0);
+
+	static uint64_t now_ns() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+
+private:
+
+	struct Counter {
+		std::atomic<uint64_t> calls{ 0 };
+		std::atomic<uint64_t> total_ns{ 0 };
+		std::atomic<uint64_t> max_ns{ 0 };
+	};
+
+	std::array<Counter, size_t(ProfileScope::COUNT)> mCounters;
+
+	FrameReport mLastFrame;
+	uint64_t mFrameStart_ns = 0;
+	uint64_t mSentAtFrameStart = 0;
+
+public:
+
+	void add(ProfileScope s_, uint64_t ns_) {
+		auto & c = mCounters[size_t(s_)];
+		c.calls.fetch_add(1, std::memory_order_relaxed);
+		c.total_ns.fetch_add(ns_, std::memory_order_relaxed);
+		uint64_t max = c.max_ns.load(std::memory_order_relaxed);
+		while (ns_ > max && !c.max_ns.compare_exchange_weak(max, ns_, std::memory_order_relaxed)) {
+		}
+	};
+
+	/// closes the current frame. sentMessages_ is the number of 3 byte
+	/// messages written to midi out ports so far, in total.
+	void endFrame(uint64_t sentMessages_);
+
+	/// the last frame closed by endFrame()
+	const FrameReport& getLastFrame() const {
+		return mLastFrame;
+	};
+};
+
+// ------------------------------------------------------
+/// \brief		times the scope it lives in, and adds it to a profiler
+/// \detail		when profiling is not compiled in, this is an empty
+/// object, which costs nothing.
+class ProfileTimer {
+#if OFX_PARAMETER_TWISTER_PROFILE
+	FrameProfiler* mProfiler;
+	ProfileScope mScope;
+	uint64_t mStart_ns;
+public:
+	ProfileTimer(FrameProfiler* profiler_, ProfileScope scope_)
+		: mProfiler(profiler_)
+		, mScope(scope_)
+		, mStart_ns(profiler_ ? FrameProfiler::now_ns() : 0) {
+	};
+	~ProfileTimer() {
+		if (mProfiler)
+			mProfiler->add(mScope, FrameProfiler::now_ns() - mStart_ns);
+	};
+#else
+public:
+	ProfileTimer(FrameProfiler*, ProfileScope) {
+	};
+#endif
+
+	ProfileTimer(const ProfileTimer&) = delete;
+	ProfileTimer& operator=(const ProfileTimer&) = delete;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		fixed-size histogram of latencies, in microseconds
+/// \detail		values below 16us get one bucket each, above that, every 
+/// power of two is split into 8 buckets, so any value is recorded 
+/// with a relative error of at most 12.5%. recording a value is a 
+/// few bit operations, and never allocates.
+/// 
+/// \note		not thread-safe - record and query from the same thread.
+class LatencyHistogram {
+
+	static const size_t LINEAR_BUCKETS = 16;
+	static const size_t SUB_BUCKETS    = 8;	 ///< buckets per power of two
+	static const size_t NUM_BUCKETS    = LINEAR_BUCKETS + (32 - 4) * SUB_BUCKETS;
+
+	std::array<uint32_t, NUM_BUCKETS> mBuckets{};
+	uint64_t mCount = 0;
+	uint32_t mMax   = 0;
+
+	static size_t bucketFor(uint32_t v_) {
+		if (v_ < LINEAR_BUCKETS) {
+			return v_;
+		}
+		// ----------| invariant: v_ >= 16, so msb >= 4
+		uint32_t msb = 31;
+		while ((v_ & (1u << msb)) == 0) {
+			--msb;
+		}
+		uint32_t sub = (v_ >> (msb - 3)) & (SUB_BUCKETS - 1);
+		return LINEAR_BUCKETS + (msb - 4) * SUB_BUCKETS + sub;
+	};
+
+	/// smallest value which falls into bucket i_
+	static uint32_t lowerBound(size_t i_) {
+		if (i_ < LINEAR_BUCKETS) {
+			return uint32_t(i_);
+		}
+		uint32_t msb = uint32_t((i_ - LINEAR_BUCKETS) / SUB_BUCKETS) + 4;
+		uint32_t sub = uint32_t((i_ - LINEAR_BUCKETS) % SUB_BUCKETS);
+		return (1u << msb) | (sub << (msb - 3));
+	};
+
+public:
+
+	void record(uint32_t v_) {
+		++mBuckets[bucketFor(v_)];
+		++mCount;
+		if (v_ > mMax) {
+			mMax = v_;
+		}
+	};
+
+	void reset() {
+		mBuckets.fill(0);
+		mCount = 0;
+		mMax = 0;
+	};
+
+	uint64_t count() const {
+		return mCount;
+	};
+
+	uint32_t max() const {
+		return mMax;
+	};
+
+	/// returns the (bucket-quantised) value below which fraction_ of 
+	/// all recorded values fall, e.g. 0.99 for the 99th percentile.
+	uint32_t percentile(double fraction_) const {
+		if (mCount == 0) {
+			return 0;
+		}
+		uint64_t rank = uint64_t(fraction_ * double(mCount - 1)) + 1;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+			seen += mBuckets[i];
+			if (seen >= rank) {
+				// never report more than we have actually seen
+				return lowerBound(i) < mMax ? lowerBound(i) : mMax;
+			}
+		}
+		return mMax;
+	};
+};
+
+} // close namespace Kontrol
+} // close namespace pal
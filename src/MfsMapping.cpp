@@ -0,0 +1,241 @@
+#include "MfsMapping.h"
+
+#include "ofUtils.h"
+#include "ofLog.h"
+
+#include <fstream>
+#include <memory>
+
+using namespace pal::Kontrol;
+
+const size_t MfsMapping::NUM_ENCODERS;
+const size_t MfsMapping::Record::MAX_TAGS;
+const uint8_t MfsMapping::Record::NONE;
+
+// ------------------------------------------------------
+
+bool MfsMapping::load(const std::string & path_) {
+
+	std::ifstream file(ofToDataPath(path_, true), std::ios::binary | std::ios::ate);
+
+	if (!file) {
+		ofLogError() << "could not open mapping file '" << path_ << "'";
+		return false;
+	}
+
+	// ----------| invariant: file is open, and positioned at its end
+
+	std::streamoff size = file.tellg();
+	if (size <= 0) {
+		ofLogError() << "mapping file '" << path_ << "' is empty";
+		return false;
+	}
+
+	// one allocation, one read - parsing reads straight from this buffer.
+	std::vector<uint8_t> data(static_cast<size_t>(size));
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+		ofLogError() << "could not read mapping file '" << path_ << "'";
+		return false;
+	}
+
+	return parse(data.data(), data.size());
+}
+
+// ------------------------------------------------------
+
+bool MfsMapping::save(const std::string & path_) const {
+
+	std::ofstream file(ofToDataPath(path_, true), std::ios::binary | std::ios::trunc);
+
+	if (!file) {
+		ofLogError() << "could not open mapping file '" << path_ << "' for writing";
+		return false;
+	}
+
+	// ----------| invariant: file is open for writing
+
+	auto data = serialize();
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return bool(file);
+}
+
+// ------------------------------------------------------
+
+bool MfsMapping::parseRecord(const uint8_t *& it_, const uint8_t * end_, size_t length_, Record & r_) {
+
+	if (length_ % 2 != 0 || size_t(end_ - it_) < length_) {
+		return false;
+	}
+
+	// ----------| invariant: record holds complete tag/value pairs, and fits
+
+	for (const uint8_t* recordEnd = it_ + length_; it_ != recordEnd; it_ += 2) {
+		if (it_[0] >= Record::MAX_TAGS || it_[1] > 0x7F) {
+			return false;
+		}
+		r_.set(it_[0], it_[1]);
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------
+
+bool MfsMapping::parse(const uint8_t * data_, size_t size_) {
+
+	// we parse into a temporary, so that a broken file leaves
+	// this mapping as it was.
+	std::unique_ptr<MfsMapping> m(new MfsMapping());
+
+	const uint8_t* it = data_;
+	const uint8_t* end = data_ + size_;
+
+	// system record: 00 <length>
+
+	if (end - it < 2 || it[0] != 0x00) {
+		ofLogError() << "mapping does not start with a system record";
+		return false;
+	}
+	size_t length = it[1];
+	it += 2;
+	if (!parseRecord(it, end, length, m->mSystem)) {
+		ofLogError() << "mapping system record is broken";
+		return false;
+	}
+
+	// encoder records: 00 <encoder 1..64> <2 bytes> <length>
+
+	for (size_t i = 0; i < NUM_ENCODERS; ++i) {
+		auto & e = m->mEncoders[i];
+
+		if (end - it < 5 || it[0] != 0x00 || it[1] != i + 1) {
+			ofLogError() << "mapping is missing the record for encoder " << i + 1;
+			return false;
+		}
+		if (it[2] > 0x7F || it[3] > 0x7F) {
+			ofLogError() << "mapping record for encoder " << i + 1 << " is not 7 bit clean";
+			return false;
+		}
+		e.header[0] = it[2];
+		e.header[1] = it[3];
+		length = it[4];
+		it += 5;
+
+		if (!parseRecord(it, end, length, e)) {
+			ofLogError() << "mapping record for encoder " << i + 1 << " is broken";
+			return false;
+		}
+	}
+
+	if (it != end) {
+		ofLogWarning() << "ignoring " << (end - it) << " bytes at end of mapping";
+	}
+
+	// ----------| invariant: all records have been parsed
+
+	mSystem = m->mSystem;
+	mEncoders = m->mEncoders;
+	mIsValid = true;
+	return true;
+}
+
+// ------------------------------------------------------
+
+void MfsMapping::serializeRecord(const Record & r_, std::vector<uint8_t>& out_) {
+	for (size_t tag = 0; tag < Record::MAX_TAGS; ++tag) {
+		if (r_.has(uint8_t(tag))) {
+			out_.push_back(uint8_t(tag));
+			out_.push_back(r_.values[tag]);
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> MfsMapping::serialize() const {
+
+	std::vector<uint8_t> out;
+	out.reserve(2 + 2 * Record::MAX_TAGS + NUM_ENCODERS * (5 + 2 * Record::MAX_TAGS));
+
+	out.push_back(0x00);
+	out.push_back(0x00); // length, patched once we know it
+	serializeRecord(mSystem, out);
+	out[1] = uint8_t(out.size() - 2);
+
+	for (size_t i = 0; i < NUM_ENCODERS; ++i) {
+		auto & e = mEncoders[i];
+		out.push_back(0x00);
+		out.push_back(uint8_t(i + 1));
+		out.push_back(e.header[0]);
+		out.push_back(e.header[1]);
+
+		size_t lengthPos = out.size();
+		out.push_back(0x00); // length, patched once we know it
+		serializeRecord(e, out);
+		out[lengthPos] = uint8_t(out.size() - lengthPos - 1);
+	}
+
+	return out;
+}
+
+// ------------------------------------------------------
+
+std::vector<std::string> MfsMapping::validate(bool relative_) const {
+
+	std::vector<std::string> problems;
+
+	if (!mIsValid) {
+		problems.push_back("mapping has not been loaded");
+		return problems;
+	}
+
+	// ----------| invariant: we have a mapping to check
+
+	for (size_t i = 0; i < NUM_ENCODERS; ++i) {
+		auto & e = mEncoders[i];
+		std::string prefix = "encoder " + ofToString(i) + ": ";
+
+		// channels are stored 1-based - we expect rotary
+		// messages on channel 0, and switch messages on channel 1.
+		if (e.get(TAG_ENCODER_CHANNEL) != 1) {
+			problems.push_back(prefix + "rotary sends on channel " + ofToString(int(e.get(TAG_ENCODER_CHANNEL)) - 1) + ", expected 0");
+		}
+		if (e.get(TAG_ENCODER_NUMBER) != i) {
+			problems.push_back(prefix + "rotary sends controller " + ofToString(int(e.get(TAG_ENCODER_NUMBER))) + ", expected " + ofToString(i));
+		}
+		if (e.get(TAG_SWITCH_CHANNEL) != 2) {
+			problems.push_back(prefix + "switch sends on channel " + ofToString(int(e.get(TAG_SWITCH_CHANNEL)) - 1) + ", expected 1");
+		}
+		if (e.get(TAG_SWITCH_NUMBER) != i) {
+			problems.push_back(prefix + "switch sends controller " + ofToString(int(e.get(TAG_SWITCH_NUMBER))) + ", expected " + ofToString(i));
+		}
+
+		// relative ticks read as absolute values make parameters jump
+		// between 0.49 and 0.51 - and absolute values read as ticks
+		// make them race off.
+		const uint8_t encoderType = relative_ ? ENCODER_TYPE_RELATIVE : ENCODER_TYPE_CC;
+		if (e.get(TAG_ENCODER_TYPE) != encoderType) {
+			problems.push_back(prefix + "rotary has encoder type " + ofToString(int(e.get(TAG_ENCODER_TYPE))) + ", expected " + ofToString(int(encoderType)) + (relative_ ? " (ENC 3FH/41H)" : " (CC)"));
+		}
+		if (e.get(TAG_SWITCH_TYPE) != SWITCH_TYPE_CC) {
+			problems.push_back(prefix + "switch has type " + ofToString(int(e.get(TAG_SWITCH_TYPE))) + ", expected " + ofToString(int(SWITCH_TYPE_CC)) + " (CC)");
+		}
+	}
+
+	return problems;
+}
+
+// ------------------------------------------------------
+
+void MfsMapping::correct(bool relative_) {
+	for (size_t i = 0; i < NUM_ENCODERS; ++i) {
+		auto & e = mEncoders[i];
+		e.set(TAG_ENCODER_CHANNEL, 1);
+		e.set(TAG_ENCODER_NUMBER, uint8_t(i));
+		e.set(TAG_ENCODER_TYPE, relative_ ? ENCODER_TYPE_RELATIVE : ENCODER_TYPE_CC);
+		e.set(TAG_SWITCH_CHANNEL, 2);
+		e.set(TAG_SWITCH_NUMBER, uint8_t(i));
+		e.set(TAG_SWITCH_TYPE, SWITCH_TYPE_CC);
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		twister configuration, as stored in .mfs files
+/// \detail		.mfs files are written by the Midi Fighter Utility, and
+/// hold the configuration of a twister as a stream of records:
+///
+///	  00 <length>                             system settings
+///	  00 <encoder 1..64> <2 bytes> <length>   encoder settings, one record per encoder
+///
+/// each record holds <length> bytes of tag/value pairs. tags are
+/// stored in ascending order, and all bytes are 7 bit clean.
+///
+/// a file is read with a single read, and parsed into flat, fixed-size
+/// tables - one per record - which map tags to values. tags we don't
+/// know about are kept, so that writing a mapping back gives the same
+/// bytes that were read.
+class MfsMapping {
+public:
+
+	static const size_t NUM_ENCODERS = 64;
+
+	// encoder settings, as tagged in .mfs files
+	enum EncoderTag : uint8_t {
+		TAG_DETENT          = 0x0a,
+		TAG_MOVEMENT        = 0x0b,
+		TAG_SWITCH_ACTION   = 0x0c,
+		TAG_SWITCH_CHANNEL  = 0x0d,	///< 1-based midi channel
+		TAG_SWITCH_NUMBER   = 0x0e, ///< controller id switch messages are sent with
+		TAG_SWITCH_TYPE     = 0x0f,
+		TAG_ENCODER_CHANNEL = 0x10,	///< 1-based midi channel
+		TAG_ENCODER_NUMBER  = 0x11, ///< controller id rotary messages are sent with
+		TAG_ENCODER_TYPE    = 0x12,
+		TAG_ACTIVE_COLOR    = 0x13,
+		TAG_INACTIVE_COLOR  = 0x14,
+		TAG_DETENT_COLOR    = 0x15,
+		TAG_INDICATOR_TYPE  = 0x16,
+		TAG_SUPER_KNOB      = 0x17,
+	};
+
+	// values of TAG_ENCODER_TYPE, and TAG_SWITCH_TYPE, in the order the
+	// Midi Fighter Utility lists them - data/mapping.mfs holds the ones
+	// ofxParameterTwister expects for absolute encoders.
+	enum EncoderType : uint8_t {
+		ENCODER_TYPE_CC       = 0x01,	///< absolute values, 0..127
+		ENCODER_TYPE_RELATIVE = 0x02,	///< "ENC 3FH/41H": 0x3F per tick down, 0x41 per tick up, see EncoderMode::RELATIVE
+	};
+
+	enum SwitchType : uint8_t {
+		SWITCH_TYPE_CC = 0x00,
+	};
+
+	/// tag -> value table for one record.
+	struct Record {
+		static const size_t MAX_TAGS = 64;
+		static const uint8_t NONE = 0xFF; ///< never a valid 7 bit value
+
+		std::array<uint8_t, MAX_TAGS> values;
+
+		Record() {
+			values.fill(NONE);
+		};
+
+		bool has(uint8_t tag_) const {
+			return tag_ < MAX_TAGS && values[tag_] != NONE;
+		};
+
+		/// returns NONE if the record does not hold tag_
+		uint8_t get(uint8_t tag_) const {
+			return tag_ < MAX_TAGS ? values[tag_] : NONE;
+		};
+
+		void set(uint8_t tag_, uint8_t v_) {
+			if (tag_ < MAX_TAGS)
+				values[tag_] = v_;
+		};
+	};
+
+	struct EncoderRecord : Record {
+		std::array<uint8_t, 2> header{ { 0x01, 0x00 } }; ///< bytes between encoder index and length - kept as read
+	};
+
+private:
+
+	Record mSystem;
+	std::array<EncoderRecord, NUM_ENCODERS> mEncoders;
+	bool mIsValid = false;
+
+	static bool parseRecord(const uint8_t*& it_, const uint8_t* end_, size_t length_, Record& r_);
+	static void serializeRecord(const Record& r_, std::vector<uint8_t>& out_);
+
+public:
+
+	/// reads path_ (relative to the data folder), and parses it.
+	/// returns false, and logs the reason, if the file can't be read,
+	/// or is not a valid mapping.
+	bool load(const std::string& path_);
+
+	/// writes the serialized mapping to path_ (relative to the data folder).
+	bool save(const std::string& path_) const;
+
+	/// parses size_ bytes of .mfs data.
+	bool parse(const uint8_t* data_, size_t size_);
+
+	/// returns the .mfs byte stream for this mapping.
+	std::vector<uint8_t> serialize() const;
+
+	bool isValid() const {
+		return mIsValid;
+	};
+
+	const Record& getSystem() const {
+		return mSystem;
+	};
+
+	/// encoder_ is 0..63, i.e. bank-major, as used by ofxParameterTwister.
+	const EncoderRecord& getEncoder(size_t encoder_) const {
+		return mEncoders[encoder_];
+	};
+
+	EncoderRecord& getEncoder(size_t encoder_) {
+		return mEncoders[encoder_];
+	};
+
+	/// checks that every encoder sends rotary messages on channel 0 and
+	/// switch messages on channel 1, as CC messages, using its own
+	/// position as controller id - and that rotaries send absolute
+	/// values, or, with relative_, "ENC 3FH/41H" ticks. this is what
+	/// ofxParameterTwister expects. returns one line per problem found,
+	/// empty if the mapping is what we expect.
+	std::vector<std::string> validate(bool relative_ = false) const;
+
+	/// sets encoder and switch channels, controller ids, and types to
+	/// what validate() expects. leaves all other settings alone.
+	void correct(bool relative_ = false);
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,268 @@
+#include "MidiRecording.h"
+
+#include "ofUtils.h"
+#include "ofLog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const char MAGIC[4] = { 'T', 'W', 'R', 'C' };
+const uint16_t VERSION = 1;
+const size_t HEADER_SIZE = 16;
+const size_t RECORD_SIZE = 12;
+
+// ------------------------------------------------------
+/// we write bytes one by one, so that files read back the
+/// same, whatever the byte order of the machine.
+void writeU16(uint8_t* p_, uint16_t v_) {
+	p_[0] = uint8_t(v_);
+	p_[1] = uint8_t(v_ >> 8);
+}
+
+uint16_t readU16(const uint8_t* p_) {
+	return uint16_t(p_[0] | (p_[1] << 8));
+}
+
+void writeU64(uint8_t* p_, uint64_t v_) {
+	for (size_t i = 0; i < 8; ++i) {
+		p_[i] = uint8_t(v_ >> (8 * i));
+	}
+}
+
+uint64_t readU64(const uint8_t* p_) {
+	uint64_t v = 0;
+	for (size_t i = 0; i < 8; ++i) {
+		v |= uint64_t(p_[i]) << (8 * i);
+	}
+	return v;
+}
+
+} // anonymous namespace
+
+// ------------------------------------------------------
+
+MidiRecorder::MidiRecorder(size_t ringCapacity_)
+	: mRing(ringCapacity_)
+	, mBuffer(ringCapacity_ * RECORD_SIZE) {
+}
+
+// ------------------------------------------------------
+
+MidiRecorder::~MidiRecorder() {
+	stop();
+}
+
+// ------------------------------------------------------
+
+bool MidiRecorder::start(const std::string & path_, uint64_t start_us_) {
+	stop();
+
+	// ----------| invariant: writer thread is not running
+
+	mFile.open(ofToDataPath(path_, true), std::ios::binary | std::ios::trunc);
+	if (!mFile) {
+		ofLogError() << "Could not open recording for writing: " << path_;
+		return false;
+	}
+
+	uint8_t header[HEADER_SIZE] = {};
+	std::memcpy(header, MAGIC, sizeof(MAGIC));
+	writeU16(header + 4, VERSION);
+	writeU16(header + 6, uint16_t(RECORD_SIZE));
+	mFile.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+
+	// producers may still have pushed events after we stopped last
+	// time - these belong to no recording, so we drop them.
+	MidiRecordingEvent e;
+	while (mRing.tryPop(e)) {
+	}
+
+	mNumWritten = 0;
+	mStart_us = start_us_;
+	mIsRecording = true;
+	mWriterThread = std::thread(&MidiRecorder::writerThreadFunction, this);
+	return true;
+}
+
+// ------------------------------------------------------
+
+void MidiRecorder::stop() {
+	if (!mWriterThread.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mIsRecording = false;
+	}
+	mWake.notify_all();
+	mWriterThread.join();
+	mFile.close();
+}
+
+// ------------------------------------------------------
+
+void MidiRecorder::writerThreadFunction() {
+
+	// midi arrives at a few thousand messages per second at most -
+	// waking up every few milliseconds keeps the ring far from full,
+	// and the file close to what was played.
+	static const auto INTERVAL = std::chrono::milliseconds(10);
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mWakeMutex);
+			mWake.wait_for(lock, INTERVAL, [this] { return !mIsRecording; });
+		}
+		drain();
+		if (!mIsRecording) {
+			break;
+		}
+	}
+
+	// whatever arrived whilst we wrote the last batch
+	drain();
+	mFile.flush();
+}
+
+// ------------------------------------------------------
+
+size_t MidiRecorder::drain() {
+	size_t count = 0;
+	size_t pos = 0;
+	MidiRecordingEvent e;
+
+	while (mRing.tryPop(e)) {
+		if (pos + RECORD_SIZE > mBuffer.size()) {
+			mFile.write(reinterpret_cast<const char*>(mBuffer.data()), pos);
+			pos = 0;
+		}
+		uint8_t* p = mBuffer.data() + pos;
+		writeU64(p, e.time_us);
+		p[8] = e.device;
+		p[9] = e.status;
+		p[10] = e.controller;
+		p[11] = e.value;
+		pos += RECORD_SIZE;
+		++count;
+	}
+
+	if (pos > 0) {
+		mFile.write(reinterpret_cast<const char*>(mBuffer.data()), pos);
+		mFile.flush();
+	}
+
+	mNumWritten += count;
+	return count;
+}
+
+// ------------------------------------------------------
+
+MidiPlayer::MidiPlayer(size_t chunkRecords_)
+	: mChunk(std::max<size_t>(chunkRecords_, 1) * RECORD_SIZE) {
+}
+
+// ------------------------------------------------------
+
+bool MidiPlayer::open(const std::string & path_, bool loop_) {
+	close();
+
+	mFile.open(ofToDataPath(path_, true), std::ios::binary);
+	if (!mFile) {
+		ofLogError() << "Could not open recording: " << path_;
+		return false;
+	}
+
+	uint8_t header[HEADER_SIZE];
+	mFile.read(reinterpret_cast<char*>(header), HEADER_SIZE);
+
+	if (!mFile
+		|| std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0
+		|| readU16(header + 4) != VERSION
+		|| readU16(header + 6) != RECORD_SIZE) {
+		ofLogError() << "Not a recording, or a recording of an unknown version: " << path_;
+		mFile.close();
+		return false;
+	}
+
+	// ----------| invariant: file is a recording, positioned at its first record
+
+	mIsLooping = loop_;
+	mLoopOffset_us = 0;
+	mLastTime_us = 0;
+	mChunkPos = 0;
+	mChunkSize = 0;
+	return true;
+}
+
+// ------------------------------------------------------
+
+void MidiPlayer::close() {
+	mFile.close();
+	mChunkPos = 0;
+	mChunkSize = 0;
+}
+
+// ------------------------------------------------------
+
+bool MidiPlayer::refill() {
+	mFile.read(reinterpret_cast<char*>(mChunk.data()), mChunk.size());
+	// a record cut short at the end of the file is ignored
+	mChunkSize = (size_t(mFile.gcount()) / RECORD_SIZE) * RECORD_SIZE;
+	mChunkPos = 0;
+
+	if (mChunkSize > 0) {
+		return true;
+	}
+
+	// ----------| invariant: we reached the end of the recording
+
+	if (!mIsLooping || mLastTime_us == 0) {
+		// an empty recording, or one where all events happened at
+		// once, would loop forever within the same frame.
+		return false;
+	}
+
+	mFile.clear();
+	mFile.seekg(HEADER_SIZE);
+	mLoopOffset_us += mLastTime_us;
+	mFile.read(reinterpret_cast<char*>(mChunk.data()), mChunk.size());
+	mChunkSize = (size_t(mFile.gcount()) / RECORD_SIZE) * RECORD_SIZE;
+	return mChunkSize > 0;
+}
+
+// ------------------------------------------------------
+
+bool MidiPlayer::next(uint64_t elapsed_us_, MidiRecordingEvent & e_) {
+	if (!isOpen()) {
+		return false;
+	}
+
+	if (mChunkPos == mChunkSize && !refill()) {
+		close();
+		return false;
+	}
+
+	// ----------| invariant: mChunk holds at least one record we have not played
+
+	const uint8_t* p = mChunk.data() + mChunkPos;
+	const uint64_t t = readU64(p);
+
+	if (t + mLoopOffset_us > elapsed_us_) {
+		return false;
+	}
+
+	e_.time_us = t + mLoopOffset_us;
+	e_.device = p[8];
+	e_.status = p[9];
+	e_.controller = p[10];
+	e_.value = p[11];
+
+	mLastTime_us = t;
+	mChunkPos += RECORD_SIZE;
+	return true;
+}
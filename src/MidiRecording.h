@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "MpscRingBuffer.h"
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		midi input, as recorded by MidiRecorder, and replayed by MidiPlayer
+/// \detail		recordings are binary files: a 16 byte header, followed by
+/// one 12 byte record per message, all little-endian:
+///
+///	  header: "TWRC" <version: u16> <record size: u16> <reserved: 8 bytes>
+///	  record: <time since recording started, us: u64> <device: u8> <status: u8> <controller: u8> <value: u8>
+///
+/// records are in the order they were received. files only ever get
+/// appended to, so a recording cut short (say, by a crash) stays
+/// readable up to its last complete record.
+struct MidiRecordingEvent {
+	uint64_t time_us = 0;	///< since the recording started
+	uint8_t device = 0;
+	uint8_t status = 0;		///< command and channel
+	uint8_t controller = 0;
+	uint8_t value = 0;
+};
+
+// ------------------------------------------------------
+/// \brief		writes midi input to a recording, on a background thread
+/// \detail		record() may be called from any number of midi driver
+/// threads at once, and never blocks, allocates, or touches the file:
+/// events go into a ring, which a writer thread drains into a buffer,
+/// and the buffer into the file. ring and buffer get allocated once,
+/// on construction. events which arrive whilst the ring is full are
+/// dropped, and counted.
+class MidiRecorder {
+
+	MpscRingBuffer<MidiRecordingEvent> mRing;
+	std::vector<uint8_t> mBuffer;			///< encoded records, waiting to be written
+
+	std::ofstream mFile;
+	std::thread mWriterThread;
+	std::mutex mWakeMutex;
+	std::condition_variable mWake;
+
+	std::atomic<bool> mIsRecording{ false };
+	std::atomic<uint64_t> mStart_us{ 0 };
+	std::atomic<uint64_t> mNumWritten{ 0 };
+
+	void writerThreadFunction();
+	size_t drain(); ///< moves events from ring to file, returns number of events moved
+
+public:
+
+	/// \param	ringCapacity_	events which may be queued between two writes
+	explicit MidiRecorder(size_t ringCapacity_ = 4096);
+	~MidiRecorder();
+
+	MidiRecorder(const MidiRecorder&) = delete;
+	MidiRecorder& operator=(const MidiRecorder&) = delete;
+
+	/// creates path_ (relative to the data folder), replacing whatever
+	/// it held. times are recorded relative to start_us_, on the steady
+	/// clock. returns false if the file can't be written.
+	bool start(const std::string& path_, uint64_t start_us_);
+
+	/// writes whatever has been recorded, and closes the file.
+	void stop();
+
+	bool isRecording() const {
+		return mIsRecording.load(std::memory_order_relaxed);
+	};
+
+	/// producer side - may be called from any thread. received_us_ is
+	/// on the steady clock. events received before recording started
+	/// are recorded at time 0.
+	void record(uint8_t device_, uint8_t status_, uint8_t controller_, uint8_t value_, uint64_t received_us_) {
+		if (!isRecording()) {
+			return;
+		}
+		// with polled input, receive times are estimated from device 
+		// time - messages queued before start() may come out earlier.
+		const uint64_t start_us = mStart_us.load(std::memory_order_relaxed);
+		MidiRecordingEvent e;
+		e.time_us = (received_us_ > start_us) ? received_us_ - start_us : 0;
+		e.device = device_;
+		e.status = status_;
+		e.controller = controller_;
+		e.value = value_;
+		mRing.tryPush(e);
+	};
+
+	uint64_t getNumWritten() const {
+		return mNumWritten.load(std::memory_order_relaxed);
+	};
+
+	uint64_t getNumDropped() const {
+		return mRing.getOverflowCount();
+	};
+};
+
+// ------------------------------------------------------
+/// \brief		streams a recording back, in time
+/// \detail		the file is read in chunks of a fixed number of records,
+/// into a buffer allocated once, on construction - so recordings of
+/// any length play in the same, small, amount of memory.
+class MidiPlayer {
+
+	std::ifstream mFile;
+	std::vector<uint8_t> mChunk;	///< records read, but not played yet
+	size_t mChunkPos = 0;			///< byte offset of the next record in mChunk
+	size_t mChunkSize = 0;			///< number of bytes in mChunk
+
+	bool mIsLooping = false;
+	uint64_t mLoopOffset_us = 0;	///< added to record times, advances with each loop
+	uint64_t mLastTime_us = 0;		///< time of the last record played
+
+	bool refill();	///< reads the next chunk, returns false at end of recording
+
+public:
+
+	/// \param	chunkRecords_	number of records read from the file at once
+	explicit MidiPlayer(size_t chunkRecords_ = 4096);
+
+	/// opens path_ (relative to the data folder). if loop_ is set, the
+	/// recording restarts once it has ended. returns false if path_
+	/// is not a recording.
+	bool open(const std::string& path_, bool loop_);
+	void close();
+
+	bool isOpen() const {
+		return mFile.is_open();
+	};
+
+	/// if the next record is due at elapsed_us_ - the time since
+	/// playback started - returns it in e_, and advances to the next
+	/// one. returns false if no record is due yet. the player closes
+	/// at the end of the recording, unless it loops.
+	bool next(uint64_t elapsed_us_, MidiRecordingEvent& e_);
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		bounded, lock-free multi-producer/single-consumer ring
+/// \detail		any number of threads may push, and exactly one thread
+/// may pop. this is what we use where several midi driver threads
+/// deliver into the same queue. like SpscRingBuffer, neither side ever
+/// blocks or allocates: if the ring is full, tryPush() fails and the
+/// overflow counter is incremented.
+///
+/// each slot carries a sequence number, which tells producers whether
+/// the slot is free to be claimed, and the consumer whether the slot
+/// has been completely written. producers claim slots by advancing the
+/// tail with a compare-and-swap, so a producer which gets pre-empted
+/// mid-write only ever holds up the consumer, never other producers.
+///
+/// storage is allocated once, on construction or reset(), and capacity
+/// is rounded up to the next power of two.
+template <typename T>
+class MpscRingBuffer {
+
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	struct Cell {
+		std::atomic<size_t> sequence{ 0 };
+		T data;
+	};
+
+	std::unique_ptr<Cell[]> mCells;
+	size_t mMask = 0;
+
+	std::atomic<size_t> mHead{ 0 };			///< next slot to read, written by consumer only
+	char mPadHead[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+	std::atomic<size_t> mTail{ 0 };			///< next slot to claim, contended by producers
+	char mPadTail[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+	std::atomic<uint64_t> mOverflowCount{ 0 };	///< number of messages dropped because ring was full
+	std::atomic<size_t> mHighWater{ 0 };		///< largest number of elements held at any time
+
+public:
+
+	explicit MpscRingBuffer(size_t capacity_ = 1024) {
+		reset(capacity_);
+	};
+
+	MpscRingBuffer(const MpscRingBuffer&) = delete;
+	MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+	/// re-allocates storage and discards any elements held.
+	/// \note not thread-safe: neither producers nor consumer may be active.
+	void reset(size_t capacity_) {
+		size_t cap = 2;
+		while (cap < capacity_) {
+			cap <<= 1;
+		}
+		mCells.reset(new Cell[cap]);
+		for (size_t i = 0; i < cap; ++i) {
+			mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		mMask = cap - 1;
+		mHead.store(0, std::memory_order_relaxed);
+		mTail.store(0, std::memory_order_relaxed);
+		mOverflowCount.store(0, std::memory_order_relaxed);
+		mHighWater.store(0, std::memory_order_relaxed);
+	};
+
+	/// producer side, may be called from any thread - returns false if ring is full.
+	bool tryPush(const T& v_) {
+		Cell* cell = nullptr;
+		size_t pos = mTail.load(std::memory_order_relaxed);
+
+		for (;;) {
+			cell = &mCells[pos & mMask];
+			const size_t seq = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+			if (diff == 0) {
+				// slot is free - try to claim it. on failure, pos
+				// is updated to the current tail, and we retry.
+				if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				// slot still holds an element from the previous lap
+				mOverflowCount.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			} else {
+				// another producer claimed this slot before us
+				pos = mTail.load(std::memory_order_relaxed);
+			}
+		}
+
+		// ----------| invariant: we own the slot at pos
+
+		cell->data = v_;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+
+		const size_t used = pos + 1 - mHead.load(std::memory_order_relaxed);
+		size_t highWater = mHighWater.load(std::memory_order_relaxed);
+		while (used > highWater &&
+			!mHighWater.compare_exchange_weak(highWater, used, std::memory_order_relaxed)) {
+		};
+		return true;
+	};
+
+	/// consumer side - returns false if ring is empty, or if the
+	/// next element is still being written.
+	bool tryPop(T& v_) {
+		const size_t pos = mHead.load(std::memory_order_relaxed);
+		Cell& cell = mCells[pos & mMask];
+
+		if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+			return false;
+		}
+
+		// ----------| invariant: slot at pos holds a completely written element
+
+		v_ = cell.data;
+		// mark the slot free for the producer one lap ahead
+		cell.sequence.store(pos + mMask + 1, std::memory_order_release);
+		mHead.store(pos + 1, std::memory_order_release);
+		return true;
+	};
+
+	/// number of elements currently held, or being written - only
+	/// approximate whilst producers or consumer are active.
+	size_t size() const {
+		const size_t head = mHead.load(std::memory_order_acquire);
+		const size_t tail = mTail.load(std::memory_order_acquire);
+		return (tail > head) ? tail - head : 0;
+	};
+
+	bool empty() const {
+		return size() == 0;
+	};
+
+	size_t capacity() const {
+		return mMask + 1;
+	};
+
+	uint64_t getOverflowCount() const {
+		return mOverflowCount.load(std::memory_order_relaxed);
+	};
+
+	size_t getHighWaterMark() const {
+		return mHighWater.load(std::memory_order_relaxed);
+	};
+
+	/// may be called from any thread - a push racing with the reset
+	/// may be lost from the high water mark.
+	void resetHighWaterMark() {
+		mHighWater.store(0, std::memory_order_relaxed);
+	};
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,111 @@
+#include "ParameterIndex.h"
+
+#include <algorithm>
+
+using namespace pal::Kontrol;
+
+// ------------------------------------------------------
+
+void ParameterIndex::setGroup(const ofParameterGroup & group_) {
+	mRoot = Node();
+	mRoot.group = group_;
+	mIsBuilt = false;
+}
+
+// ------------------------------------------------------
+
+bool ParameterIndex::refresh() {
+	if (!mIsBuilt) {
+		mRoot.build(0);
+		mIsBuilt = true;
+		return true;
+	}
+
+	// ----------| invariant: index has been built before
+
+	return mRoot.refresh(0);
+}
+
+// ------------------------------------------------------
+
+void ParameterIndex::Node::build(size_t depth_) {
+
+	children.assign(group.begin(), group.end());
+
+	// subgroups we built before are kept, and only refreshed - 
+	// so adding a parameter to a group does not re-build the 
+	// groups it holds.
+	std::vector<std::unique_ptr<Node>> previous;
+	previous.swap(subgroups);
+
+	if (depth_ < MAX_DEPTH) {
+		for (auto & c : children) {
+			auto g = std::dynamic_pointer_cast<ofParameterGroup>(c);
+			if (!g) {
+				continue;
+			}
+
+			auto it = std::find_if(previous.begin(), previous.end(), [&g](const std::unique_ptr<Node>& n) {
+				return n && n->group.isReferenceTo(*g);
+			});
+
+			if (it != previous.end()) {
+				subgroups.push_back(std::move(*it));
+				subgroups.back()->refresh(depth_ + 1);
+			} else {
+				subgroups.emplace_back(new Node());
+				subgroups.back()->group = *g;
+				subgroups.back()->build(depth_ + 1);
+			}
+		}
+	}
+
+	gatherLeaves();
+}
+
+// ------------------------------------------------------
+
+bool ParameterIndex::Node::refresh(size_t depth_) {
+
+	const bool isUnchanged = children.size() == group.size() && std::equal(children.begin(), children.end(), group.begin());
+
+	if (!isUnchanged) {
+		// this group has changed - we re-build it, and refresh 
+		// the subgroups it still holds.
+		build(depth_);
+		return true;
+	}
+
+	// ----------| invariant: this group holds what it held before, but
+	// groups further down may have changed.
+
+	bool hasChanged = false;
+	for (auto & s : subgroups) {
+		hasChanged |= s->refresh(depth_ + 1);
+	}
+
+	if (hasChanged) {
+		gatherLeaves();
+	}
+
+	return hasChanged;
+}
+
+// ------------------------------------------------------
+
+void ParameterIndex::Node::gatherLeaves() {
+
+	leaves.clear();
+
+	auto s = subgroups.begin();
+	for (auto & c : children) {
+		if (!std::dynamic_pointer_cast<ofParameterGroup>(c)) {
+			leaves.push_back(c);
+		} else if (s != subgroups.end()) {
+			// subgroups are in the same order as the children they
+			// belong to - groups beyond MAX_DEPTH have no node.
+			leaves.insert(leaves.end(), (*s)->leaves.begin(), (*s)->leaves.end());
+			++s;
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "ofParameter.h"
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		flattened list of all parameters in a tree of groups
+/// \detail		an ofParameterGroup may hold other groups, which may hold
+/// groups in turn. the index holds every parameter which is not a group
+/// (the "leaves") in one flat list, depth first, in the order the groups
+/// list them - so that leaf n can be found without walking the tree.
+///
+/// the index is built lazily, on the first call to refresh(). each group
+/// in the tree remembers what it held when it was last built, so that a
+/// later refresh() only re-builds the groups which have changed since.
+class ParameterIndex {
+
+	struct Node {
+		ofParameterGroup group;
+		std::vector<std::shared_ptr<ofAbstractParameter>> children;	///< as last seen
+		std::vector<std::unique_ptr<Node>> subgroups;				///< one per child which is a group, in order
+		std::vector<std::shared_ptr<ofAbstractParameter>> leaves;	///< all parameters below this node, depth first
+
+		void build(size_t depth_);
+		bool refresh(size_t depth_);
+		void gatherLeaves();
+	};
+
+	Node mRoot;
+	bool mIsBuilt = false;
+
+public:
+
+	/// groups nested deeper than this are ignored - this is what
+	/// keeps a group which (indirectly) holds itself from recursing
+	/// forever.
+	static const size_t MAX_DEPTH = 16;
+
+	/// points the index at group_. the tree is not walked until the
+	/// next refresh().
+	void setGroup(const ofParameterGroup& group_);
+
+	const ofParameterGroup& getGroup() const {
+		return mRoot.group;
+	};
+
+	/// builds the index on first call - afterwards, re-builds only
+	/// the groups which have changed since the last call. returns
+	/// true if the leaves may have changed.
+	bool refresh();
+
+	/// all parameters in the tree which are not groups, depth first.
+	/// only valid after refresh().
+	const std::vector<std::shared_ptr<ofAbstractParameter>>& getLeaves() const {
+		return mRoot.leaves;
+	};
+};
+
+} // close namespace Kontrol
+} // close namespace pal
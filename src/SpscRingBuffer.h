@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		bounded, wait-free single-producer/single-consumer ring
+/// \detail		exactly one thread may push, and exactly one (other) thread
+/// may pop. neither side ever blocks, locks, or allocates: if the ring
+/// is full, tryPush() fails and the overflow counter is incremented;
+/// if the ring is empty, tryPop() fails.
+///
+/// storage is allocated once, on construction or reset(), and capacity
+/// is rounded up to the next power of two.
+template <typename T>
+class SpscRingBuffer {
+
+	// head and tail live on separate cache lines, so that producer
+	// and consumer don't keep invalidating each other's cache.
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	std::vector<T> mRing;
+	size_t mMask = 0;
+
+	std::atomic<size_t> mHead{ 0 };			///< next slot to read, written by consumer only
+	char mPadHead[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+	std::atomic<size_t> mTail{ 0 };			///< next slot to write, written by producer only
+	char mPadTail[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+	std::atomic<uint64_t> mOverflowCount{ 0 };	///< number of messages dropped because ring was full
+	std::atomic<size_t> mHighWater{ 0 };		///< largest number of elements held at any time
+
+public:
+
+	explicit SpscRingBuffer(size_t capacity_ = 1024) {
+		reset(capacity_);
+	};
+
+	SpscRingBuffer(const SpscRingBuffer&) = delete;
+	SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+	/// re-allocates storage and discards any elements held.
+	/// \note not thread-safe: neither producer nor consumer may be active.
+	void reset(size_t capacity_) {
+		size_t cap = 2;
+		while (cap < capacity_) {
+			cap <<= 1;
+		}
+		mRing.assign(cap, T());
+		mMask = cap - 1;
+		mHead.store(0, std::memory_order_relaxed);
+		mTail.store(0, std::memory_order_relaxed);
+		mOverflowCount.store(0, std::memory_order_relaxed);
+		mHighWater.store(0, std::memory_order_relaxed);
+	};
+
+	/// producer side - returns false if ring is full.
+	bool tryPush(const T& v_) {
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		const size_t used = tail - mHead.load(std::memory_order_acquire);
+		if (used > mMask) {
+			mOverflowCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		// ----------| invariant: there is at least one free slot
+
+		mRing[tail & mMask] = v_;
+		mTail.store(tail + 1, std::memory_order_release);
+
+		if (used + 1 > mHighWater.load(std::memory_order_relaxed)) {
+			mHighWater.store(used + 1, std::memory_order_relaxed);
+		}
+		return true;
+	};
+
+	/// consumer side - returns false if ring is empty.
+	bool tryPop(T& v_) {
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		// ----------| invariant: there is at least one element
+
+		v_ = mRing[head & mMask];
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	};
+
+	/// number of elements currently held - only approximate
+	/// whilst producer or consumer are active.
+	size_t size() const {
+		return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+	};
+
+	bool empty() const {
+		return size() == 0;
+	};
+
+	size_t capacity() const {
+		return mMask + 1;
+	};
+
+	uint64_t getOverflowCount() const {
+		return mOverflowCount.load(std::memory_order_relaxed);
+	};
+
+	size_t getHighWaterMark() const {
+		return mHighWater.load(std::memory_order_relaxed);
+	};
+
+	/// may be called from any thread - a push racing with the reset
+	/// may be lost from the high water mark.
+	void resetHighWaterMark() {
+		mHighWater.store(0, std::memory_order_relaxed);
+	};
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,302 @@
+#include "StateMirror.h"
+
+#include "ofxNetwork.h"
+#include "ofLog.h"
+
+#include <cstring>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const char MAGIC[3] = { 'T', 'W', 'M' };
+const uint8_t VERSION = 1;
+const size_t HEADER_SIZE = 10;
+const size_t SECTION_SIZE = 10;		///< without values
+const uint8_t FLAG_KEYFRAME = 0x1;
+const uint8_t FINE_BIT = 0x80;
+
+/// largest udp payload, so that no datagram gets cut short
+const size_t RECEIVE_BUFFER_SIZE = 65507;
+
+// ------------------------------------------------------
+
+void writeU16(uint8_t* p_, uint16_t v_) {
+	p_[0] = uint8_t(v_);
+	p_[1] = uint8_t(v_ >> 8);
+}
+
+uint16_t readU16(const uint8_t* p_) {
+	return uint16_t(p_[0] | (p_[1] << 8));
+}
+
+void writeU32(uint8_t* p_, uint32_t v_) {
+	for (size_t i = 0; i < 4; ++i) {
+		p_[i] = uint8_t(v_ >> (8 * i));
+	}
+}
+
+uint32_t readU32(const uint8_t* p_) {
+	uint32_t v = 0;
+	for (size_t i = 0; i < 4; ++i) {
+		v |= uint32_t(p_[i]) << (8 * i);
+	}
+	return v;
+}
+
+} // anonymous namespace
+
+// ------------------------------------------------------
+
+MirrorSender::MirrorSender()
+	: mDatagram(MAX_DATAGRAM) {
+}
+
+// ------------------------------------------------------
+
+MirrorSender::~MirrorSender() {
+	if (mUdp) {
+		mUdp->Close();
+	}
+}
+
+// ------------------------------------------------------
+
+bool MirrorSender::setup(const std::string & host_, int port_) {
+	mUdp.reset(new ofxUDPManager());
+
+	if (!mUdp->Create()
+		|| !mUdp->SetEnableBroadcast(true)
+		|| !mUdp->Connect(host_.c_str(), (unsigned short)(port_))) {
+		ofLogError() << "Could not set up state mirror sender to " << host_ << ":" << port_;
+		mUdp.reset();
+		return false;
+	}
+
+	// a frame must never wait for the network
+	mUdp->SetNonBlocking(true);
+	return true;
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::begin(bool isKeyframe_) {
+	mIsKeyframe = isKeyframe_;
+	beginDatagram();
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::beginDatagram() {
+	uint8_t* p = mDatagram.data();
+	std::memcpy(p, MAGIC, sizeof(MAGIC));
+	p[3] = VERSION;
+	writeU32(p + 4, mSequence++);
+	p[8] = mIsKeyframe ? FLAG_KEYFRAME : 0;
+	p[9] = 0;
+	mSize = HEADER_SIZE;
+	mCountPos = 0;
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::openSection() {
+	uint8_t* p = mDatagram.data() + mSize;
+	p[0] = mSection.device;
+	for (size_t i = 0; i < mSection.bankPages.size(); ++i) {
+		writeU16(p + 1 + 2 * i, mSection.bankPages[i]);
+	}
+	p[9] = 0;
+	mCountPos = mSize + 9;
+	mSize += SECTION_SIZE;
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::addDevice(const MirrorDevice & device_) {
+	mSection = device_;
+
+	if (mSize + SECTION_SIZE + 3 > mDatagram.size()) {
+		send();
+		beginDatagram();
+	}
+
+	// ----------| invariant: there is room for the section, and one value
+
+	openSection();
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::addValue(uint8_t encoder_, uint16_t value_, bool isFine_) {
+	const size_t size = isFine_ ? 3 : 2;
+
+	if (mCountPos == 0) {
+		ofLogError() << "mirror value added outside a device section";
+		return;
+	}
+
+	// ----------| invariant: a section is open
+
+	if (mSize + size > mDatagram.size() || mDatagram[mCountPos] == 255) {
+		// the section continues in the next datagram
+		send();
+		beginDatagram();
+		openSection();
+	}
+
+	uint8_t* p = mDatagram.data() + mSize;
+	if (isFine_) {
+		p[0] = encoder_ | FINE_BIT;
+		p[1] = uint8_t((value_ >> 7) & 0x7F);
+		p[2] = uint8_t(value_ & 0x7F);
+	} else {
+		p[0] = encoder_;
+		p[1] = uint8_t(value_ & 0x7F);
+	}
+	mSize += size;
+	++mDatagram[mCountPos];
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::end() {
+	if (mCountPos != 0) {
+		send();
+	}
+	mSize = 0;
+	mCountPos = 0;
+}
+
+// ------------------------------------------------------
+
+void MirrorSender::send() {
+	if (!mUdp) {
+		return;
+	}
+	// a datagram which can't be sent is lost - the next keyframe
+	// brings followers back in line.
+	if (mUdp->Send(reinterpret_cast<const char*>(mDatagram.data()), int(mSize)) == int(mSize)) {
+		++mNumSent;
+	} else {
+		++mNumFailed;
+	}
+}
+
+// ------------------------------------------------------
+
+MirrorReceiver::MirrorReceiver()
+	: mBuffer(RECEIVE_BUFFER_SIZE) {
+}
+
+// ------------------------------------------------------
+
+MirrorReceiver::~MirrorReceiver() {
+	if (mUdp) {
+		mUdp->Close();
+	}
+}
+
+// ------------------------------------------------------
+
+bool MirrorReceiver::setup(int port_) {
+	mUdp.reset(new ofxUDPManager());
+
+	// several followers may run on the same machine
+	if (!mUdp->Create()
+		|| !mUdp->SetReuseAddress(true)
+		|| !mUdp->Bind((unsigned short)(port_))) {
+		ofLogError() << "Could not listen for state mirror on port " << port_;
+		mUdp.reset();
+		return false;
+	}
+
+	mUdp->SetNonBlocking(true);
+	mHasSequence = false;
+	return true;
+}
+
+// ------------------------------------------------------
+
+bool MirrorReceiver::receive(MirrorFrame & frame_) {
+	if (!mUdp) {
+		return false;
+	}
+
+	// ----------| invariant: we are listening
+
+	while (true) {
+		const int size = mUdp->Receive(reinterpret_cast<char*>(mBuffer.data()), int(mBuffer.size()));
+		if (size <= 0) {
+			return false;
+		}
+		if (parse(size_t(size), frame_)) {
+			++mNumReceived;
+			return true;
+		}
+		++mNumDropped;
+	}
+}
+
+// ------------------------------------------------------
+
+bool MirrorReceiver::parse(size_t size_, MirrorFrame & frame_) {
+	const uint8_t* p = mBuffer.data();
+
+	if (size_ < HEADER_SIZE || std::memcmp(p, MAGIC, sizeof(MAGIC)) != 0 || p[3] != VERSION) {
+		return false;
+	}
+
+	const uint32_t sequence = readU32(p + 4);
+	frame_.isKeyframe = (p[8] & FLAG_KEYFRAME) != 0;
+
+	if (mHasSequence && !frame_.isKeyframe && int32_t(sequence - mLastSequence) <= 0) {
+		// overtaken by a later datagram
+		return false;
+	}
+
+	// ----------| invariant: datagram is new, read its sections
+
+	frame_.devices.clear();
+	frame_.values.clear();
+
+	size_t pos = HEADER_SIZE;
+	while (pos < size_) {
+		if (pos + SECTION_SIZE > size_) {
+			return false;
+		}
+		MirrorDevice d;
+		d.device = p[pos];
+		for (size_t i = 0; i < d.bankPages.size(); ++i) {
+			d.bankPages[i] = readU16(p + pos + 1 + 2 * i);
+		}
+		const uint8_t count = p[pos + 9];
+		pos += SECTION_SIZE;
+		frame_.devices.push_back(d);
+
+		for (uint8_t i = 0; i < count; ++i) {
+			if (pos + 2 > size_) {
+				return false;
+			}
+			MirrorValue v;
+			v.device = d.device;
+			v.encoder = p[pos] & ~FINE_BIT;
+			v.isFine = (p[pos] & FINE_BIT) != 0;
+			if (v.isFine) {
+				if (pos + 3 > size_) {
+					return false;
+				}
+				v.value = uint16_t(((p[pos + 1] & 0x7F) << 7) | (p[pos + 2] & 0x7F));
+				pos += 3;
+			} else {
+				v.value = p[pos + 1] & 0x7F;
+				pos += 2;
+			}
+			frame_.values.push_back(v);
+		}
+	}
+
+	mLastSequence = sequence;
+	mHasSequence = true;
+	return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// ofxNetwork pulls in platform socket headers - we keep these out
+// of every translation unit which includes the addon.
+class ofxUDPManager;
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		controller state, as mirrored from one node to others
+/// \detail		the node with the twister sends one datagram per frame,
+/// holding the values applied from midi since the last frame - plus,
+/// periodically, a keyframe holding every bound encoder, so that nodes
+/// which join late catch up. all little-endian:
+///
+///	  header:  "TWM" <version: u8> <sequence: u32> <flags: u8, bit 0: keyframe> <reserved: u8>
+///	  section: <device: u8> <page per bank: 4 x u16> <count: u8> <count values>
+///	  value:   <encoder: u8, bit 7: fine> <msb: u8> [<lsb: u8> if fine]
+///
+/// values are either 7 bit, as received from the device, or - marked
+/// "fine" - 14 bit normalised targets, for relative encoders. switch
+/// values are never coalesced, so that presses shorter than a frame
+/// still reach followers. a frame which does not fit into one datagram
+/// continues in the next one.
+struct MirrorValue {
+	uint8_t device = 0;
+	uint8_t encoder = 0;	///< 0..63
+	bool isFine = false;	///< 14 bit normalised value, rather than a 7 bit midi value
+	uint16_t value = 0;
+
+	static const uint16_t FINE_MAX = 16383;
+};
+
+struct MirrorDevice {
+	uint8_t device = 0;
+	std::array<uint16_t, 4> bankPages{ { 0, 1, 2, 3 } };
+};
+
+/// one datagram, as received
+struct MirrorFrame {
+	bool isKeyframe = false;
+	std::vector<MirrorDevice> devices;	///< devices with a section in this datagram, in order
+	std::vector<MirrorValue> values;	///< values of all sections, in order
+};
+
+// ------------------------------------------------------
+/// \brief		sends mirrored state, one frame at a time
+/// \detail		begin() a frame, add sections and values, end() it. the
+/// datagram buffer is allocated once, on construction.
+class MirrorSender {
+
+	std::unique_ptr<ofxUDPManager> mUdp;
+	std::vector<uint8_t> mDatagram;
+	size_t mSize = 0;				///< bytes in mDatagram
+	size_t mCountPos = 0;			///< offset of the current section's count, 0 if no section is open
+	MirrorDevice mSection;			///< repeated at the start of a datagram which continues a section
+
+	uint32_t mSequence = 0;
+	bool mIsKeyframe = false;
+
+	uint64_t mNumSent = 0;
+	uint64_t mNumFailed = 0;
+
+	void beginDatagram();
+	void openSection();
+	void send();
+
+public:
+
+	/// largest datagram we send - safely below the mtu of an ethernet link
+	static const size_t MAX_DATAGRAM = 1200;
+
+	MirrorSender();
+	~MirrorSender();
+
+	/// host_ may be a broadcast address, to reach all nodes on a subnet.
+	/// returns false if the socket can't be set up.
+	bool setup(const std::string& host_, int port_);
+
+	void begin(bool isKeyframe_);
+	void addDevice(const MirrorDevice& device_);
+	void addValue(uint8_t encoder_, uint16_t value_, bool isFine_);
+	void end();
+
+	uint64_t getNumSent() const {
+		return mNumSent;
+	};
+
+	uint64_t getNumFailed() const {
+		return mNumFailed;
+	};
+};
+
+// ------------------------------------------------------
+/// \brief		receives mirrored state
+/// \detail		datagrams which arrive out of order, i.e. with a sequence
+/// number older than the last one received, are dropped - unless they
+/// are keyframes, which always apply, so that a sender which restarts
+/// is picked up again by its first keyframe.
+class MirrorReceiver {
+
+	std::unique_ptr<ofxUDPManager> mUdp;
+	std::vector<uint8_t> mBuffer;
+
+	bool mHasSequence = false;
+	uint32_t mLastSequence = 0;
+
+	uint64_t mNumReceived = 0;
+	uint64_t mNumDropped = 0;	///< out of order, or malformed
+
+	bool parse(size_t size_, MirrorFrame& frame_);
+
+public:
+
+	MirrorReceiver();
+	~MirrorReceiver();
+
+	/// listens on port_. returns false if the port can't be bound.
+	bool setup(int port_);
+
+	/// reads the next pending datagram into frame_. returns false if
+	/// there is none. never blocks.
+	bool receive(MirrorFrame& frame_);
+
+	uint64_t getNumReceived() const {
+		return mNumReceived;
+	};
+
+	uint64_t getNumDropped() const {
+		return mNumDropped;
+	};
+};
+
+} // close namespace Kontrol
+} // close namespace pal
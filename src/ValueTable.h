@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace pal {
+namespace Kontrol {
+
+// ------------------------------------------------------
+/// \brief		latest value per encoder, readable from any thread
+/// \detail		written by exactly one thread - the midi callback of the
+/// device the table belongs to - and read by any number of threads, at
+/// whatever rate they like. neither side ever blocks, locks, or allocates.
+///
+/// each entry packs the latest 7 bit value together with a change count
+/// into one atomic word, so readers always see a value and its count
+/// consistently, and can tell whether anything has arrived since they
+/// last looked. every entry sits on its own cache line, so that readers
+/// polling one encoder don't slow down the writer updating another.
+class ValueTable {
+
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	struct Entry {
+		std::atomic<uint32_t> word{ 0 };	///< bits 0..7: value, bits 8..31: change count
+		char mPad[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+	};
+
+public:
+
+	static const size_t NUM_CONTROLS = 64;
+
+	enum Control : uint8_t {
+		ROTARY = 0,	///< values received on channel 0
+		SWITCH,		///< values received on channel 1
+		CONTROL_COUNT,
+	};
+
+private:
+
+	std::array<std::array<Entry, NUM_CONTROLS>, CONTROL_COUNT> mEntries;
+
+public:
+
+	ValueTable() = default;
+	ValueTable(const ValueTable&) = delete;
+	ValueTable& operator=(const ValueTable&) = delete;
+
+	/// writer side - the midi callback only.
+	void publish(Control control_, size_t encoder_, uint8_t v_) {
+		if (control_ >= CONTROL_COUNT || encoder_ >= NUM_CONTROLS) {
+			return;
+		}
+
+		// ----------| invariant: entry exists
+
+		auto & word = mEntries[control_][encoder_].word;
+		// we are the only writer, so no need for a read-modify-write.
+		const uint32_t count = (word.load(std::memory_order_relaxed) >> 8) + 1;
+		word.store((count << 8) | v_, std::memory_order_release);
+	};
+
+	/// latest 7 bit value received - 0 if none has arrived yet.
+	uint8_t getValue(Control control_, size_t encoder_) const {
+		return uint8_t(load(control_, encoder_) & 0xFF);
+	};
+
+	/// latest rotary value, normalised 0..1
+	float getNormalized(size_t encoder_) const {
+		return getValue(ROTARY, encoder_) / 127.f;
+	};
+
+	bool getSwitch(size_t encoder_) const {
+		return getValue(SWITCH, encoder_) > 63;
+	};
+
+	/// number of values received for this encoder - wraps at 2^24.
+	/// if this has not changed since the last read, neither has the value.
+	uint32_t getChangeCount(Control control_, size_t encoder_) const {
+		return load(control_, encoder_) >> 8;
+	};
+
+	/// value, and change count, read together.
+	uint8_t getValue(Control control_, size_t encoder_, uint32_t& changeCount_) const {
+		const uint32_t word = load(control_, encoder_);
+		changeCount_ = word >> 8;
+		return uint8_t(word & 0xFF);
+	};
+
+private:
+
+	uint32_t load(Control control_, size_t encoder_) const {
+		if (control_ >= CONTROL_COUNT || encoder_ >= NUM_CONTROLS) {
+			return 0;
+		}
+		return mEntries[control_][encoder_].word.load(std::memory_order_acquire);
+	};
+};
+
+} // close namespace Kontrol
+} // close namespace pal
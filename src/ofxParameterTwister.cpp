@@ -3,236 +3,2895 @@
 #include "RtMidi.h"
 
 #include "ofParameter.h"
+#include "ofColor.h"
+#include "ofVectorMath.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+#include <cmath>
+#include <type_traits>
 
 using namespace pal::Kontrol;
 
+// in-class initialised constants still need a definition whenever 
+// they bind to a reference - e.g. when streamed into a log message.
+const size_t ofxParameterTwister::NUM_BANKS;
+const size_t ofxParameterTwister::ENCODERS_PER_BANK;
+const size_t ofxParameterTwister::NUM_ENCODERS;
+const size_t ofxParameterTwister::PAGE_CACHE_SIZE;
+const uint8_t ofxParameterTwister::SIDE_BUTTON_FIRST_CC;
+const uint8_t ofxParameterTwister::SIDE_BUTTONS_PER_BANK;
+
+// ------------------------------------------------------
+/// \brief		static callback for midi controller
+/// \detail		all this callback does is translate the message into a midi messge object,
+/// tag it with the device it came from, and then pass is on to the shared 
+/// midi in queue so it can be processed in update.
+/// \note		this runs on the midi driver thread, and must never block, 
+/// allocate, or log. with several devices, this may run on several 
+/// threads at once.
+void ofxParameterTwister::_midi_callback(double deltatime, unsigned char status, unsigned char data1, unsigned char data2, void *device)
+{
+	auto d = static_cast<Device*>(device);
+	ProfileTimer profile(&d->owner->mProfiler, ProfileScope::MIDI_CALLBACK);
+
+	MidiInMessage m;
+	receiveMessage(*d, deltatime, status, data1, data2, m);
+
+	// if the queue is full, the message is dropped, 
+	// and the queue's overflow count goes up.
+	d->owner->mMidiInQueue.tryPush(m);
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::receiveMessage(Device & d_, double deltatime_, uint8_t status_, uint8_t controller_, uint8_t value_, MidiInMessage & m_) {
+
+	// rtmidi gives us the time since the previous message -
+	// we accumulate this to get the device-side timeline.
+	d_.deviceTime += deltatime_;
+
+	m_.msg.command_channel = status_;
+	m_.msg.controller = controller_;
+	m_.msg.value = value_;
+	m_.device = d_.id;
+	m_.deviceTime = d_.deviceTime;
+
+	const uint64_t now_us = steady_clock_us();
+
+	if (!d_.owner->mSettings.pollInput) {
+		m_.received_us = now_us;
+	} else {
+		// polled messages may have waited in RtMidi's queue for up 
+		// to a frame. we place them on the steady clock by their 
+		// device time, so that acceleration still sees the time 
+		// between messages. no message can have arrived later than 
+		// now - the smallest offset seen is the closest estimate.
+		const int64_t deviceTime_us = int64_t(d_.deviceTime * 1e6);
+		const int64_t offset_us = int64_t(now_us) - deviceTime_us;
+		if (!d_.hasPollOffset || offset_us < d_.pollOffset_us) {
+			d_.pollOffset_us = offset_us;
+			d_.hasPollOffset = true;
+		}
+		m_.received_us = uint64_t(deviceTime_us + d_.pollOffset_us);
+	}
+
+	d_.owner->mTrace.traceIn(m_.msg, d_.id);
+	d_.owner->mRecorder.record(d_.id, m_.msg.command_channel, m_.msg.controller, m_.msg.value, m_.received_us);
+
+	if (d_.owner->mSettings.publishValues && (m_.msg.command_channel & 0xF0) == 0xB0) {
+		// rotary values arrive on channel 0, switch values on channel 1
+		const uint8_t channel = m_.msg.command_channel & 0x0F;
+		if (channel < ValueTable::CONTROL_COUNT) {
+			d_.values.publish(ValueTable::Control(channel), m_.msg.controller, m_.msg.value);
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::pollDevices() {
+
+	MidiInMessage m;
+
+	for (auto & d : mDevices) {
+		if (d->connection == nullptr || d->isLost) {
+			continue;
+		}
+
+		// ----------| invariant: device is connected - only update() 
+		// changes connections once they are handed to a device.
+
+		auto midiIn = d->connection->midiIn;
+		while (true) {
+			double deltatime = midiIn->getMessage(&mPollMessage);
+			if (mPollMessage.empty()) {
+				break;
+			}
+			// message will come in three bytes, with the first byte == 176.
+			if (mPollMessage.size() == 3) {
+				receiveMessage(*d, deltatime, mPollMessage[0], mPollMessage[1], mPollMessage[2], m);
+				processMessage(m);
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::~ofxParameterTwister() {
+	stopSmoothingWorker();
+	stopConnectThread();
+	// connections, and devices, must be gone before the 
+	// queue their callbacks write to.
+	mOpened.clear();
+	mRetired.clear();
+	mDevices.clear();
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::Device::Device() {
+	for (size_t i = 0; i < NUM_ENCODERS; ++i) {
+		encoders[i].pos = uint8_t(i);
+		encoders[i].mMasks = &masks;
+	}
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::Device::~Device() {
+	// sender thread must be gone before we delete the port it writes to.
+	outQueue.stopSenderThread();
+	outQueue.setMidiOut(nullptr);
+	connection.reset();
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::Connection::~Connection() {
+	if (midiIn != nullptr) {
+		midiIn->closePort();
+		delete midiIn;
+		midiIn = nullptr;
+	}
+	if (midiOut != nullptr) {
+		midiOut->closePort();
+		delete midiOut;
+		midiOut = nullptr;
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setup() {
+	setup(Settings());
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setup(const Settings& settings_) {
+
+	stopSmoothingWorker();
+	stopConnectThread();
+
+	mOpened.clear();
+	mRetired.clear();
+	mDevices.clear();
+	mNamesInUse.clear();
+	mLostNames.clear();
+
+	mSettings = settings_;
+
+	mMidiInQueue.reset(settings_.inputQueueCapacity);
+	mTrace.setup(settings_.traceCapacity);
+
+	// there is always at least one device, so that 
+	// parameters can be bound before any twister is found.
+	addDevice();
+
+	if (!settings_.openDevicesInBackground) {
+		try {
+			RtMidiIn probeIn;
+			RtMidiOut probeOut;
+			scanPorts(probeIn, probeOut);
+		}
+		catch (RtMidiError &error)
+		{
+			std::cout << "MIDI exception:" << std::endl;
+			error.printMessage();
+		}
+		
+		// nothing else holds the lock yet, so this adopts everything opened.
+		updateConnections();
+
+		if (!isConnected(0)) {
+			ofLogWarning() << "no midi ports found matching '" << settings_.portName << "'";
+		}
+	}
+
+	// the connection thread also closes the ports of lost twisters, 
+	// so it runs even if we don't watch for new ones.
+	mShouldConnect = true;
+	mConnectThread = std::thread(&ofxParameterTwister::connectThreadFunction, this, settings_.openDevicesInBackground);
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::Device & ofxParameterTwister::addDevice() {
+	
+	mDevices.emplace_back(new Device());
+
+	auto & d = *mDevices.back();
+	d.owner = this;
+	d.id = uint8_t(mDevices.size() - 1);
+
+	for (auto & e : d.encoders) {
+		e.mProfiler = &mProfiler;
+	}
+
+	d.outQueue.setTrace(&mTrace, d.id);
+	d.outQueue.setup(mSettings.outputQueueCapacity);
+	d.outQueue.setBatchingEnabled(mSettings.batchOutput);
+
+	// each device gets its own sender thread, so that each 
+	// midi link is paced separately.
+	if (mSettings.useSenderThread) {
+		d.outQueue.startSenderThread(mSettings.senderMessagesPerMs);
+	}
+
+	return d;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stopConnectThread() {
+	if (!mConnectThread.joinable()) {
+		return;
+	}
+
+	// ----------| invariant: connection thread is running
+
+	{
+		std::lock_guard<std::mutex> lock(mConnectMutex);
+		mShouldConnect = false;
+	}
+	mConnectWake.notify_one();
+	mConnectThread.join();
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::connectThreadFunction(bool scanFirst_) {
+
+	// ports are enumerated through probes which we keep for the 
+	// lifetime of the thread, as creating a midi client may be slow.
+	std::unique_ptr<RtMidiIn> probeIn;
+	std::unique_ptr<RtMidiOut> probeOut;
+
+	try {
+		probeIn.reset(new RtMidiIn());
+		probeOut.reset(new RtMidiOut());
+	}
+	catch (RtMidiError &error)
+	{
+		std::cout << "MIDI exception:" << std::endl;
+		error.printMessage();
+		probeIn.reset();
+		probeOut.reset();
+	}
+
+	bool needsScan = scanFirst_;
+	
+	auto shouldWake = [this] {
+		return !mShouldConnect || !mRetired.empty();
+	};
+
+	std::unique_lock<std::mutex> lock(mConnectMutex);
+
+	while (mShouldConnect) {
+
+		if (needsScan) {
+			lock.unlock();
+			if (probeIn && probeOut) {
+				scanPorts(*probeIn, *probeOut);
+			} else {
+				// we can't scan, but we still close what got retired.
+				std::vector<std::unique_ptr<Connection>> retired;
+				{
+					std::lock_guard<std::mutex> retiredLock(mConnectMutex);
+					retired.swap(mRetired);
+				}
+			}
+			lock.lock();
+		}
+		
+		needsScan = true;
+
+		// we wake up early if update() has retired connections, as 
+		// the twister they belonged to might be back already.
+		if (mSettings.watchdogIntervalSeconds > 0.f) {
+			mConnectWake.wait_for(lock, std::chrono::duration<float>(mSettings.watchdogIntervalSeconds), shouldWake);
+		} else {
+			mConnectWake.wait(lock, shouldWake);
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+namespace {
+
+/// ALSA port names end in " <client>:<port>" - returns name_ without it.
+std::string withoutClientSuffix(const std::string& name_) {
+	size_t space = name_.find_last_of(' ');
+	if (space == std::string::npos) {
+		return name_;
+	}
+	const std::string suffix = name_.substr(space + 1);
+	const size_t colon = suffix.find(':');
+	const bool isClientPort = colon != std::string::npos && colon > 0 && colon + 1 < suffix.size()
+		&& suffix.find_first_not_of("0123456789:") == std::string::npos
+		&& suffix.find(':', colon + 1) == std::string::npos;
+	return isClientPort ? name_.substr(0, space) : name_;
+}
+
+} // anonymous namespace
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::scanPorts(RtMidiIn& probeIn_, RtMidiOut& probeOut_) {
+
+	std::vector<std::unique_ptr<Connection>> retired;
+	std::vector<std::string> inUse;
+
+	{
+		std::lock_guard<std::mutex> lock(mConnectMutex);
+		retired.swap(mRetired);
+		inUse = mNamesInUse;
+		for (auto & c : mOpened) {
+			inUse.push_back(c->name);
+		}
+	}
+
+	// ports of twisters which have gone get closed here, 
+	// outside the lock, as this may take a while.
+	retired.clear();
+
+	// we enumerate ports exactly once per scan, and keep 
+	// the names of all ports which belong to twisters.
+	
+	typedef std::pair<size_t, std::string> Port; // port number, port name
+	std::vector<Port> inPorts;
+	std::vector<Port> outPorts;
+
+	const std::string & portName = mSettings.portName;
+
+	try {
+		size_t numPorts = probeIn_.getPortCount();
+		for (size_t i = 0; i < numPorts; ++i) {
+			// we don't match on the start of the port name, as 
+			// some drivers prefix names of repeated devices, e.g.
+			// "2- Midi Fighter Twister".
+			std::string name = probeIn_.getPortName(i);
+			if (name.find(portName) != std::string::npos)
+				inPorts.emplace_back(i, name);
+		}
+		numPorts = probeOut_.getPortCount();
+		for (size_t i = 0; i < numPorts; ++i) {
+			std::string name = probeOut_.getPortName(i);
+			if (name.find(portName) != std::string::npos)
+				outPorts.emplace_back(i, name);
+		}
+	}
+	catch (RtMidiError &error)
+	{
+		std::cout << "MIDI exception:" << std::endl;
+		error.printMessage();
+		return;
+	}
+
+	// ----------| invariant: we know which ports belong to twisters
+
+	// a twister is one ALSA client, so its input and output have the 
+	// same name, suffix and all. virtual twisters - as the benchmark 
+	// opens - have one client per direction, so their names differ in
+	// the client number. an input without an output of its name takes
+	// the only output left over which differs in nothing but that.
+	for (auto & in : inPorts) {
+		auto isPaired = [](const std::vector<Port>& ports_, const std::string& name_) {
+			return std::any_of(ports_.begin(), ports_.end(), [&name_](const Port& p) { return p.second == name_; });
+		};
+		if (isPaired(outPorts, in.second)) {
+			continue;
+		}
+		const std::string base = withoutClientSuffix(in.second);
+		Port* candidate = nullptr;
+		size_t numCandidates = 0;
+		for (auto & out : outPorts) {
+			if (out.second != in.second && withoutClientSuffix(out.second) == base && !isPaired(inPorts, out.second)) {
+				candidate = &out;
+				++numCandidates;
+			}
+		}
+		if (numCandidates == 1) {
+			candidate->second = in.second;
+		}
+	}
+
+	// every twister shows up as one input, and one output port of the 
+	// same name. names are not necessarily unique, so we count: if 
+	// there are fewer twisters of a name than we hold connections of 
+	// that name, connections have gone - if there are more, new 
+	// twisters have been plugged in.
+
+	std::vector<std::string> names = inUse;
+	for (auto & p : inPorts) {
+		names.push_back(p.second);
+	}
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+
+	std::vector<std::unique_ptr<Connection>> opened;
+	std::vector<std::string> lost;
+
+	for (auto & name : names) {
+		
+		std::vector<size_t> ins, outs;
+		for (auto & p : inPorts) {
+			if (p.second == name) ins.push_back(p.first);
+		}
+		for (auto & p : outPorts) {
+			if (p.second == name) outs.push_back(p.first);
+		}
+
+		size_t numPresent = std::min(ins.size(), outs.size());
+		size_t numUsed = std::count(inUse.begin(), inUse.end(), name);
+
+		if (numPresent < numUsed) {
+			// we can't tell which of the twisters of this 
+			// name has gone, so they all get re-connected.
+			lost.push_back(name);
+			continue;
+		}
+
+		for (size_t i = numUsed; i < numPresent; ++i) {
+			std::unique_ptr<Connection> c(new Connection());
+			c->name = name;
+			try {
+				// RtMidi's own queue only holds messages if we poll - 
+				// with a callback, messages go straight to our queue.
+				c->midiIn = new RtMidiIn(RtMidi::UNSPECIFIED, "RtMidi Input Client", 
+					mSettings.pollInput ? unsigned(mSettings.inputQueueCapacity) : 100);
+				c->midiIn->openPort(ins[i]);
+				// Don't ignore sysex, timing, or active sensing messages.
+				c->midiIn->ignoreTypes(true, true, true);
+
+				c->midiOut = new RtMidiOut();
+				c->midiOut->openPort(outs[i]);
+			}
+			catch (RtMidiError &error)
+			{
+				// ports may have changed since we enumerated them - 
+				// the next scan will try again.
+				std::cout << "MIDI exception:" << std::endl;
+				error.printMessage();
+				continue;
+			}
+			opened.emplace_back(std::move(c));
+		}
+	}
+
+	if (opened.empty() && lost.empty()) {
+		return;
+	}
+
+	// ----------| invariant: there is news for update()
+
+	std::lock_guard<std::mutex> lock(mConnectMutex);
+	for (auto & c : opened) {
+		mOpened.emplace_back(std::move(c));
+	}
+	mLostNames.insert(mLostNames.end(), lost.begin(), lost.end());
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::updateConnections() {
+
+	std::unique_lock<std::mutex> lock(mConnectMutex, std::try_to_lock);
+	
+	if (!lock.owns_lock()) {
+		return;
+	}
+
+	// ----------| invariant: we hold the lock, and must not talk to drivers
+
+	std::vector<size_t> disconnected;
+	std::vector<size_t> connected;
+
+	for (auto & name : mLostNames) {
+		for (auto & d : mDevices) {
+			if (d->connection && d->connection->name == name)
+				d->isLost = true;
+		}
+	}
+	mLostNames.clear();
+
+	for (auto & d : mDevices) {
+		if (d->connection == nullptr) 
+			continue;
+		
+		if (d->outQueue.hasSendFailed()) {
+			d->isLost = true;
+		}
+
+		if (!d->isLost) 
+			continue;
+
+		// ----------| invariant: device has lost its connection
+
+		if (!d->outQueue.trySetMidiOut(nullptr)) {
+			// a message is being sent right now - we try again next frame.
+			continue;
+		}
+
+		auto it = std::find(mNamesInUse.begin(), mNamesInUse.end(), d->connection->name);
+		if (it != mNamesInUse.end()) {
+			mNamesInUse.erase(it);
+		}
+		mRetired.emplace_back(std::move(d->connection));
+		d->isLost = false;
+		disconnected.push_back(d->id);
+	}
+
+	for (auto & c : mOpened) {
+		
+		// a twister which comes back gets the device it had before. 
+		// otherwise, it takes a device which has never been connected, 
+		// or a new device.
+		Device* d = nullptr;
+		for (auto & candidate : mDevices) {
+			if (candidate->connection == nullptr && candidate->name == c->name) {
+				d = candidate.get();
+				break;
+			}
+		}
+		for (auto it = mDevices.begin(); d == nullptr && it != mDevices.end(); ++it) {
+			if ((*it)->connection == nullptr && (*it)->name.empty()) 
+				d = it->get();
+		}
+		if (d == nullptr) {
+			if (mDevices.size() > UINT8_MAX) {
+				// device ids are 8 bit - we can't take any more twisters.
+				mRetired.emplace_back(std::move(c));
+				continue;
+			}
+			d = &addDevice();
+		}
+
+		// ----------| invariant: d is a device without connection
+
+		d->connection = std::move(c);
+		d->name = d->connection->name;
+		mNamesInUse.push_back(d->name);
+
+		d->outQueue.setMidiOut(d->connection->midiOut);
+		if (mSettings.pollInput) {
+			// the device timeline restarts with the new port
+			d->hasPollOffset = false;
+		} else {
+			d->connection->midiIn->setShortCallback(&_midi_callback, d);
+		}
+
+		// we don't know what the twister shows, so we replay 
+		// the full state of all banks, starting with our bank.
+		for (auto & e : d->encoders) {
+			e.invalidateShadow();
+		}
+		d->bankChangePending = true;
+		
+		connected.push_back(d->id);
+	}
+	mOpened.clear();
+
+	bool hasRetired = !mRetired.empty();
+	
+	lock.unlock();
+
+	if (hasRetired) {
+		mConnectWake.notify_one();
+	}
+
+	// listeners may call back into us, so we notify without the lock.
+	for (auto id : disconnected) {
+		ofNotifyEvent(deviceDisconnected, id);
+	}
+	for (auto id : connected) {
+		ofNotifyEvent(deviceConnected, id);
+	}
+}
+
+// ------------------------------------------------------
+
+namespace {
+
+// how to get at the components of a parameter value - one 
+// specialisation per parameter type RotaryBinder knows about.
+template<typename T>
+struct ComponentTraits;
+
+template<>
+struct ComponentTraits<float> {
+	static const size_t COUNT = 1;
+	static float get(const float& v_, size_t) { return v_; }
+	static void set(float& v_, size_t, float c_) { v_ = c_; }
+};
+
+template<>
+struct ComponentTraits<int> {
+	static const size_t COUNT = 1;
+	static float get(const int& v_, size_t) { return float(v_); }
+	static void set(int& v_, size_t, float c_) { v_ = int(std::round(c_)); }
+};
+
+template<typename P>
+struct ComponentTraits<ofColor_<P>> {
+	static const size_t COUNT = 4; ///< r, g, b, a - on adjacent encoders
+	static float get(const ofColor_<P>& v_, size_t i_) { return float(v_[i_]); }
+	static void set(ofColor_<P>& v_, size_t i_, float c_) {
+		v_[i_] = P(std::is_integral<P>::value ? std::round(c_) : c_);
+	}
+};
+
+template<typename V, size_t N>
+struct VectorComponentTraits {
+	static const size_t COUNT = N; ///< x, y (, z) - on adjacent encoders
+	static float get(const V& v_, size_t i_) { return v_[int(i_)]; }
+	static void set(V& v_, size_t i_, float c_) { v_[int(i_)] = c_; }
+};
+
+template<>
+struct ComponentTraits<glm::vec2> : VectorComponentTraits<glm::vec2, 2> {};
+
+template<>
+struct ComponentTraits<glm::vec3> : VectorComponentTraits<glm::vec3, 3> {};
+
+} // anonymous namespace
+
+// ------------------------------------------------------
+
+template<typename T>
+struct ofxParameterTwister::RotaryBinder {
+
+	typedef ComponentTraits<T> Traits;
+
+	// registry has matched the type already, so no need for a dynamic cast.
+	static ofParameter<T>& param(const Binding& b_) {
+		return *static_cast<ofParameter<T>*>(b_.param.get());
+	}
+
+	// we read the range whenever we map, as bindings are 
+	// cached, and the parameter's range may have changed since.
+
+	static float normalize(const Binding& b_, const T& v_) {
+		auto & p = param(b_);
+		return ofMap(Traits::get(v_, b_.component), Traits::get(p.getMin(), b_.component), Traits::get(p.getMax(), b_.component), 0.f, 1.f, true);
+	}
+
+	static float readNormalized(const Binding& b_) {
+		return normalize(b_, param(b_).get());
+	}
+
+	static void setNormalized(const Binding& b_, float n_) {
+		auto & p = param(b_);
+		T v = p.get();
+		Traits::set(v, b_.component, ofMap(n_, 0.f, 1.f, Traits::get(p.getMin(), b_.component), Traits::get(p.getMax(), b_.component), true));
+		p.set(v);
+	}
+
+	static void updateParameter(const Binding& b_, uint8_t v_) {
+		// on midi input
+		setNormalized(b_, v_ / 127.f);
+	}
+
+	static uint8_t readValue(const Binding& b_) {
+		return uint8_t(readNormalized(b_) * 127.f);
+	}
+
+	static ofEventListener listen(const Binding& b_, Encoder& e_) {
+		// on parameter change, write from parameter to midi.
+		const Binding* b = &b_;
+		return param(b_).newListener([&e_, b](T v_) {
+			ProfileTimer profile(e_.mProfiler, ProfileScope::LISTENER_DISPATCH);
+			e_.setValue(uint8_t(normalize(*b, v_) * 127.f));
+		});
+	}
+
+	static size_t bind(Binding* b_, size_t available_, const std::shared_ptr<ofAbstractParameter>&) {
+		static const BindingOps ops = { &updateParameter, &readValue, &readNormalized, &setNormalized, &listen };
+
+		if (Traits::COUNT > available_) {
+			return 0;
+		}
+
+		// ----------| invariant: there is an encoder for each component
+
+		for (size_t i = 0; i < Traits::COUNT; ++i) {
+			b_[i].state = Encoder::State::ROTARY;
+			b_[i].ops = &ops;
+			b_[i].component = uint8_t(i);
+		}
+		return Traits::COUNT;
+	}
+};
+
+// ------------------------------------------------------
+
+struct ofxParameterTwister::SwitchBinder {
+
+	static ofParameter<bool>& param(const Binding& b_) {
+		return *static_cast<ofParameter<bool>*>(b_.param.get());
+	}
+
+	static void updateParameter(const Binding& b_, uint8_t v_) {
+		param(b_).set((v_ > 63) ? true : false);
+	}
+
+	static uint8_t readValue(const Binding& b_) {
+		return (param(b_) == true) ? 127 : 0;
+	}
+
+	static ofEventListener listen(const Binding& b_, Encoder& e_) {
+		return param(b_).newListener([&e_](bool v_) {
+			ProfileTimer profile(e_.mProfiler, ProfileScope::LISTENER_DISPATCH);
+			e_.setValue(v_ == true ? 127 : 0);
+		});
+	}
+
+	static size_t bind(Binding* b_, size_t, const std::shared_ptr<ofAbstractParameter>&) {
+		static const BindingOps ops = { &updateParameter, &readValue, nullptr, nullptr, &listen };
+		b_->state = Encoder::State::SWITCH;
+		b_->ops = &ops;
+		return 1;
+	}
+};
+
+// ------------------------------------------------------
+
+struct ofxParameterTwister::TriggerBinder {
+
+	static void updateParameter(const Binding& b_, uint8_t v_) {
+		// switches send 127 on press - and, if programmed as 
+		// momentary, 0 on release, which we ignore.
+		if (v_ > 63) {
+			static_cast<ofParameter<void>*>(b_.param.get())->trigger();
+		}
+	}
+
+	static uint8_t readValue(const Binding&) {
+		return 0;
+	}
+
+	static ofEventListener listen(const Binding&, Encoder&) {
+		// triggers have no state to show
+		return ofEventListener();
+	}
+
+	static size_t bind(Binding* b_, size_t, const std::shared_ptr<ofAbstractParameter>&) {
+		static const BindingOps ops = { &updateParameter, &readValue, nullptr, nullptr, &listen };
+		b_->state = Encoder::State::SWITCH;
+		b_->ops = &ops;
+		return 1;
+	}
+};
+
+// ------------------------------------------------------
+
+const ofxParameterTwister::BinderRegistry & ofxParameterTwister::getBinderRegistry()
+{
+	// built once, on first use. 
+	// to support a new parameter type, add a binder here.
+	static const BinderRegistry registry = [] {
+		BinderRegistry r;
+		r.add<float>(&RotaryBinder<float>::bind);
+		r.add<int>(&RotaryBinder<int>::bind);
+		r.add<ofColor>(&RotaryBinder<ofColor>::bind);
+		r.add<ofFloatColor>(&RotaryBinder<ofFloatColor>::bind);
+		r.add<glm::vec2>(&RotaryBinder<glm::vec2>::bind);
+		r.add<glm::vec3>(&RotaryBinder<glm::vec3>::bind);
+		r.add<bool>(&SwitchBinder::bind);
+		r.add<void>(&TriggerBinder::bind);
+		return r;
+	}();
+	return registry;
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::PageCacheEntry& ofxParameterTwister::preparePage(const ofParameterGroup & group_)
+{
+	auto it = std::find_if(mPageCache.begin(), mPageCache.end(), [&group_](const PageCacheEntry& c) {
+		return c.index.getGroup().isReferenceTo(group_);
+	});
+
+	if (it != mPageCache.end()) {
+		// move to front, as most recently used
+		mPageCache.splice(mPageCache.begin(), mPageCache, it);
+		if (!it->index.refresh()) {
+			// if we have seen this group before, and it still holds the 
+			// same parameters, the bindings we prepared are still good.	
+			return *it;
+		}
+	} else {
+		mPageCache.emplace_front();
+		mPageCache.front().index.setGroup(group_);
+		mPageCache.front().index.refresh();
+
+		// we evict the least recently used page which no device 
+		// follows - pages which devices follow must stay, as 
+		// their encoders point to the bindings.
+		if (mPageCache.size() > PAGE_CACHE_SIZE) {
+			for (auto c = std::prev(mPageCache.end()); c != mPageCache.begin(); --c) {
+				bool isFollowed = std::any_of(mDevices.begin(), mDevices.end(), [&c](const std::unique_ptr<Device>& d) {
+					return d->page == &*c;
+				});
+				if (!isFollowed && c->numSnapshots == 0) {
+					mPageCache.erase(c);
+					break;
+				}
+			}
+		}
+	}
+
+	// ----------| invariant: page is at front of cache, its index is 
+	// up to date, but its bindings need preparing
+
+	auto & page = mPageCache.front();
+	const auto & registry = getBinderRegistry();
+	const auto & leaves = page.index.getLeaves();
+
+	std::vector<Binding> bindings;
+	bindings.reserve(std::max(size_t(NUM_ENCODERS), leaves.size() + ENCODERS_PER_BANK));
+
+	for (auto & p : leaves) {
+		size_t first = bindings.size();
+		size_t available = ENCODERS_PER_BANK - first % ENCODERS_PER_BANK;
+		
+		// room for a full page - we trim what the binder didn't use.
+		bindings.resize(first + ENCODERS_PER_BANK);
+		
+		Binder binder = registry.find(*p);
+		size_t numBound = (binder != nullptr) ? binder(&bindings[first], available, p) : 0;
+
+		if (binder != nullptr && numBound == 0 && available < ENCODERS_PER_BANK) {
+			// parameters spread over several encoders never straddle
+			// pages - this one starts the next page instead.
+			std::fill(bindings.begin() + first, bindings.end(), Binding());
+			first += available;
+			bindings.resize(first + ENCODERS_PER_BANK);
+			numBound = binder(&bindings[first], ENCODERS_PER_BANK, p);
+		}
+
+		if (numBound == 0) {
+			// we cannot match this parameter, unfortunately - 
+			// its encoder stays disabled.
+			bindings[first] = Binding();
+			numBound = 1;
+		} else {
+			for (size_t j = first; j < first + numBound; ++j) {
+				bindings[j].param = p;
+			}
+		}
+
+		bindings.resize(first + numBound);
+	}
+
+	// whole pages only, and at least one page for each bank
+	size_t numPages = std::max(size_t(NUM_BANKS), (bindings.size() + ENCODERS_PER_BANK - 1) / ENCODERS_PER_BANK);
+	bindings.resize(numPages * ENCODERS_PER_BANK);
+
+	// encoders following this page still point to the old bindings, 
+	// and read them whilst re-binding - so they stay alive until 
+	// setParams() has re-bound every device following this page.
+	page.bindings.swap(bindings);
+	page.retiredBindings.swap(bindings);
+	page.generation = mNextPageGeneration++;
+
+	return page;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setParams(const ofParameterGroup& group_, size_t device_)
+{
+	/*
+
+	based on incoming parameters,
+	we set our Encoders to track them
+
+	*/
+
+	if (device_ > UINT8_MAX) {
+		ofLogError() << "cannot set params for device " << device_ << ", device ids are 8 bit";
+		return;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	ProfileTimer profile(&mProfiler, ProfileScope::SET_PARAMS);
+
+	// twisters may not have been found yet - binding to a device 
+	// we haven't seen yet reserves it for the next twister found.
+	while (device_ >= mDevices.size()) {
+		addDevice();
+	}
+
+	// ----------| invariant: device_ is valid
+
+	auto & page = preparePage(group_);
+
+	auto & d = *mDevices[device_];
+	if (d.page != &page) {
+		// a new group starts out on its first pages
+		d.page = &page;
+		for (size_t i = 0; i < NUM_BANKS; ++i) {
+			d.bankPages[i] = i;
+		}
+	}
+
+	// preparing the page may have re-built bindings which other 
+	// devices follow, so we re-bind every device following this page.
+	for (auto & other : mDevices) {
+		if (other->page == &page)
+			bindDevice(*other);
+	}
+
+	// ----------| invariant: no encoder points to retired bindings
+
+	std::vector<Binding>().swap(page.retiredBindings);
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::bindDevice(Device & d_) {
+	for (size_t i = 0; i < NUM_BANKS; ++i) {
+		bindBank(d_, i);
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::bindBank(Device & d_, size_t bank_) {
+
+	if (d_.page == nullptr) {
+		return;
+	}
+
+	// ----------| invariant: device follows a page
+
+	// when fine-tuning, every bank follows the first bank's page.
+	size_t page = (mBankLayout == BankLayout::FINE_TUNE) ? d_.bankPages[0] : d_.bankPages[bank_];
+	const Binding* bindings = d_.page->getPage(page);
+
+	// encoders only send what differs between their current state, 
+	// and the state their new binding requires.
+	for (size_t i = 0; i < ENCODERS_PER_BANK; ++i) {
+		const auto & b = bindings[i];
+		auto & e = d_.encoders[bank_ * ENCODERS_PER_BANK + i];
+		e.mDetectAnimation = mDetectAnimations;
+		e.bind(b.state != Encoder::State::DISABLED ? &b : nullptr, mSyncMode == SyncMode::LISTENERS);
+		if (!mAnimationFlags.empty()) {
+			applyAnimationFlag(e);
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setPage(size_t page_, size_t device_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	if (device_ >= mDevices.size()) {
+		ofLogError() << "cannot flip pages on device " << device_ << ", only " << mDevices.size() << " devices set up";
+		return;
+	}
+
+	auto & d = *mDevices[device_];
+	
+	if (d.page == nullptr) {
+		ofLogError() << "cannot flip pages on device " << device_ << ", it has no parameters bound";
+		return;
+	}
+
+	// ----------| invariant: device_ is valid, and has pages
+
+	page_ = std::min(page_, d.page->getNumPages() - 1);
+
+	if (mBankLayout == BankLayout::FINE_TUNE) {
+		// all banks show the same page, at different resolutions
+		d.bankPages[0] = page_;
+		bindDevice(d);
+	} else {
+		d.bankPages[d.activeBank] = page_;
+		bindBank(d, d.activeBank);
+	}
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::getPage(size_t device_) const {
+	if (device_ >= mDevices.size()) {
+		return 0;
+	}
+	auto & d = *mDevices[device_];
+	return (mBankLayout == BankLayout::FINE_TUNE) ? d.bankPages[0] : d.bankPages[d.activeBank];
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::getNumPages(size_t device_) const {
+	if (device_ >= mDevices.size() || mDevices[device_]->page == nullptr) {
+		return 0;
+	}
+	return mDevices[device_]->page->getNumPages();
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setEncoderMode(EncoderMode mode_, float maxAcceleration_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	mEncoderMode = mode_;
+	mMaxAcceleration = std::max(1.f, maxAcceleration_);
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setBankLayout(BankLayout layout_) {
+	if (layout_ == BankLayout::FINE_TUNE && mEncoderMode != EncoderMode::RELATIVE) {
+		ofLogWarning() << "fine-tune banks need relative encoders - see setEncoderMode()";
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	mBankLayout = layout_;
+
+	for (auto & d : mDevices) {
+		bindDevice(*d);
+	}
+}
+
+// ------------------------------------------------------
+
+float ofxParameterTwister::getTickRange(size_t bank_) const {
+	// 128 ticks move a parameter by this fraction of its range
+	static const float fineTuneRange[NUM_BANKS] = { 1.f, 1.f / 2.f, 1.f / 4.f, 1.f / 16.f };
+	return (mBankLayout == BankLayout::FINE_TUNE) ? fineTuneRange[bank_ % NUM_BANKS] : 1.f;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::applyMessage(Device & d_, Encoder & e_, const MidiInMessage & m_) {
+	if (mEncoderMode == EncoderMode::RELATIVE && e_.mState == Encoder::State::ROTARY) {
+		applyRelative(d_, e_, e_.accelerate(m_.msg.value, m_.received_us, mMaxAcceleration));
+	} else {
+		applyAbsolute(d_, e_, m_.msg.value);
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::applyAbsolute(Device & d_, Encoder & e_, uint8_t v_) {
+	// the device shows what it has sent already
+	e_.receive(v_);
+
+	if (mSmoothing != Smoothing::NONE && e_.mState == Encoder::State::ROTARY && e_.canSmooth()) {
+		e_.startSmoothing(v_ / 127.f, steady_clock_us(), true);
+		d_.masks.smoothing |= (1ULL << e_.pos);
+	} else {
+		e_.mIsApplyingInput = true;
+		e_.updateParameter(v_);
+		e_.mIsApplyingInput = false;
+	}
+
+	if (mMirrorSender) {
+		mirrorValue(d_, e_, v_, false);
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::applyRelative(Device & d_, Encoder & e_, float ticks_) {
+	float range = getTickRange(e_.pos / ENCODERS_PER_BANK);
+	if (mSmoothing != Smoothing::NONE && e_.canSmooth()) {
+		// relative encoders show what we tell them, so smoothing steps get sent
+		e_.startSmoothing(e_.advanceRelative(ticks_, range), steady_clock_us(), false);
+		d_.masks.smoothing |= (1ULL << e_.pos);
+	} else {
+		e_.nudgeParameter(ticks_, range);
+	}
+
+	if (mMirrorSender) {
+		// ticks only make sense against our own position - followers 
+		// get where the parameter is headed instead.
+		const float target = (d_.masks.smoothing & e_.bit()) ? e_.mSmoothTarget : e_.mBinding->ops->readNormalized(*e_.mBinding);
+		mirrorValue(d_, e_, uint16_t(std::round(target * MirrorValue::FINE_MAX)), true);
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setSmoothing(Smoothing mode_, float time_, uint32_t budget_us_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	// a time constant of zero would mean no smoothing at all
+	mSmoothing = (time_ > 0.f) ? mode_ : Smoothing::NONE;
+	mSmoothingTime = time_;
+	mSmoothingBudget_us = budget_us_;
+
+	if (mSmoothing == Smoothing::NONE) {
+		// parameters which are still converging jump to their target
+		for (auto & d : mDevices) {
+			for (auto & e : d->encoders) {
+				if (e.mIsSmoothing) {
+					e.writeNormalized(e.mSmoothTarget);
+					e.mIsSmoothing = false;
+				}
+			}
+			d->masks.smoothing = 0;
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stepSmoothing(uint64_t now_us_) {
+
+	const size_t total = mDevices.size() * NUM_ENCODERS;
+
+	if (mSmoothing == Smoothing::NONE || total == 0) {
+		return;
+	}
+
+	// ----------| invariant: we are smoothing
+
+	const uint64_t deadline = now_us_ + mSmoothingBudget_us;
+	
+	// we start where the last step ran out of budget, so that all 
+	// encoders get their turn, however tight the budget.
+	for (size_t k = 0; k < total;) {
+		size_t idx = (mSmoothingCursor + k) % total;
+		auto & d = *mDevices[idx / NUM_ENCODERS];
+		size_t i = idx % NUM_ENCODERS;
+
+		if (d.masks.smoothing == 0) {
+			// nothing converging on this device - skip to the next one
+			k += NUM_ENCODERS - i;
+			continue;
+		}
+
+		++k;
+
+		if ((d.masks.smoothing & (1ULL << i)) == 0) {
+			continue;
+		}
+
+		// ----------| invariant: encoder is converging
+
+		auto & e = d.encoders[i];
+		if (!e.mIsSmoothing || !e.stepSmoothing(mSmoothing, mSmoothingTime, now_us_)) {
+			// encoder has settled, or has been re-bound
+			d.masks.smoothing &= ~(1ULL << i);
+		}
+
+		if (steady_clock_us() > deadline) {
+			mSmoothingCursor = (idx + 1) % total;
+			return;
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::startSmoothingWorker(float rateHz_) {
+	if (mSmoothingWorker.joinable() || rateHz_ <= 0.f) {
+		return;
+	}
+
+	// ----------| invariant: no worker running yet, and rate is valid
+
+	mSmoothingWorkerShouldRun = true;
+	mSmoothingWorker = std::thread([this, rateHz_] {
+		typedef std::chrono::steady_clock clock;
+		const auto interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(1.f / rateHz_));
+		auto next = clock::now();
+
+		while (mSmoothingWorkerShouldRun) {
+			{
+				std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+				stepSmoothing(steady_clock_us());
+			}
+			// we advance by a fixed interval, so that the rate 
+			// does not drift with the time each step takes.
+			next += interval;
+			std::this_thread::sleep_until(next);
+		}
+	});
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stopSmoothingWorker() {
+	if (!mSmoothingWorker.joinable()) {
+		return;
+	}
+
+	// ----------| invariant: worker is running
+
+	mSmoothingWorkerShouldRun = false;
+	mSmoothingWorker.join();
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::getNumDevices() const {
+	return mDevices.size();
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::isConnected(size_t device_) const {
+	return device_ < mDevices.size() && mDevices[device_]->connection != nullptr && !mDevices[device_]->isLost;
+}
+
+// ------------------------------------------------------
+
+const std::string & ofxParameterTwister::getDeviceName(size_t device_) const {
+	static const std::string noName;
+	return (device_ < mDevices.size()) ? mDevices[device_]->name : noName;
+}
+
+// ------------------------------------------------------
+
+float ofxParameterTwister::readSnapshotValue(const Binding & b_) {
+	if (b_.ops == nullptr) {
+		return 0.f;
+	}
+	if (b_.ops->readNormalized != nullptr) {
+		return b_.ops->readNormalized(b_);
+	}
+	return (b_.ops->readValue(b_) > 63) ? 1.f : 0.f;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::applySnapshotValue(const Binding & b_, float v_) {
+	if (b_.ops == nullptr) {
+		return;
+	}
+
+	// ----------| invariant: binding has a parameter
+
+	if (b_.ops->setNormalized != nullptr) {
+		// we only set what differs, so that listeners for 
+		// parameters which don't change stay quiet.
+		if (b_.ops->readNormalized(b_) != v_) {
+			b_.ops->setNormalized(b_, v_);
+		}
+	} else if (b_.state == Encoder::State::SWITCH && b_.ops->readValue(b_) != (v_ > 0.5f ? 127 : 0)) {
+		b_.ops->updateParameter(b_, v_ > 0.5f ? 127 : 0);
+	}
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::storeSnapshot(size_t device_) {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	Snapshot snapshot;
+
+	if (device_ >= mDevices.size() || mDevices[device_]->page == nullptr) {
+		ofLogError() << "cannot store snapshot for device " << device_ << ", it has no parameters bound";
+	} else {
+		auto & page = *mDevices[device_]->page;
+
+		snapshot.page = &page;
+		snapshot.generation = page.generation;
+		snapshot.offset = mSnapshotValues.size();
+		snapshot.count = page.bindings.size();
+		++page.numSnapshots;
+
+		mSnapshotValues.reserve(mSnapshotValues.size() + page.bindings.size());
+		for (auto & b : page.bindings) {
+			mSnapshotValues.push_back(readSnapshotValue(b));
+		}
+	}
+
+	// a snapshot which could not be stored still gets an id, 
+	// which can't be recalled.
+	mSnapshots.push_back(snapshot);
+	return mSnapshots.size() - 1;
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::recallSnapshot(size_t snapshot_, float morphSeconds_) {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	if (snapshot_ >= mSnapshots.size() || mSnapshots[snapshot_].page == nullptr) {
+		ofLogError() << "cannot recall snapshot " << snapshot_ << ", no such snapshot";
+		return false;
+	}
+
+	auto & snapshot = mSnapshots[snapshot_];
+	auto & bindings = snapshot.page->bindings;
+
+	if (snapshot.generation != snapshot.page->generation) {
+		ofLogWarning() << "cannot recall snapshot " << snapshot_ << ", its parameters have changed since it was stored";
+		return false;
+	}
+
+	// ----------| invariant: snapshot still matches the bindings of its page
+
+	const float* values = &mSnapshotValues[snapshot.offset];
+
+	if (morphSeconds_ <= 0.f) {
+		mMorph.isActive = false;
+		for (size_t i = 0; i < bindings.size(); ++i) {
+			applySnapshotValue(bindings[i], values[i]);
+		}
+		return true;
+	}
+
+	// ----------| invariant: we morph - from where parameters are now
+
+	mMorph.isActive = true;
+	mMorph.snapshot = snapshot_;
+	mMorph.start_us = steady_clock_us();
+	mMorph.duration_us = uint64_t(morphSeconds_ * 1e6f);
+	mMorph.from.resize(bindings.size());
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		mMorph.from[i] = readSnapshotValue(bindings[i]);
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stepMorph(uint64_t now_us_) {
+
+	if (!mMorph.isActive) {
+		return;
+	}
+
+	auto & snapshot = mSnapshots[mMorph.snapshot];
+
+	if (snapshot.page == nullptr || snapshot.generation != snapshot.page->generation) {
+		// snapshot has gone, or its parameters have changed mid-morph
+		mMorph.isActive = false;
+		return;
+	}
+
+	// ----------| invariant: morph is valid
+
+	auto & bindings = snapshot.page->bindings;
+	const float* to = &mSnapshotValues[snapshot.offset];
+	
+	float t = std::min(1.f, float(now_us_ - mMorph.start_us) / float(std::max<uint64_t>(1, mMorph.duration_us)));
+
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		const auto & b = bindings[i];
+		if (b.ops == nullptr) {
+			continue;
+		}
+		if (b.ops->setNormalized != nullptr) {
+			applySnapshotValue(b, mMorph.from[i] + (to[i] - mMorph.from[i]) * t);
+		} else if (t >= 1.f) {
+			// switches have no in-between
+			applySnapshotValue(b, to[i]);
+		}
+	}
+
+	mMorph.isActive = (t < 1.f);
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::deleteSnapshot(size_t snapshot_) {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	if (snapshot_ >= mSnapshots.size() || mSnapshots[snapshot_].page == nullptr) {
+		return;
+	}
+
+	// ----------| invariant: snapshot exists
+
+	auto & snapshot = mSnapshots[snapshot_];
+	
+	if (snapshot.offset + snapshot.count == mSnapshotValues.size()) {
+		// snapshot is last in the arena, so we can give its space back.
+		// space in the middle of the arena is only freed by clearSnapshots().
+		mSnapshotValues.resize(snapshot.offset);
+	}
+
+	--snapshot.page->numSnapshots;
+	snapshot.page = nullptr;
+
+	if (mMorph.isActive && mMorph.snapshot == snapshot_) {
+		mMorph.isActive = false;
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::clearSnapshots() {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	for (auto & s : mSnapshots) {
+		if (s.page != nullptr) {
+			--s.page->numSnapshots;
+		}
+	}
+	mSnapshots.clear();
+	mSnapshotValues.clear();
+	mMorph.isActive = false;
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::isMorphing() const {
+	return mMorph.isActive;
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::startRecording(const std::string & path_) {
+	return mRecorder.start(path_, steady_clock_us());
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stopRecording() {
+	mRecorder.stop();
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::isRecording() const {
+	return mRecorder.isRecording();
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::startPlayback(const std::string & path_, bool loop_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	mHasPendingPlayback = false;
+	mPlaybackStart_us = steady_clock_us();
+	return mPlayer.open(path_, loop_);
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stopPlayback() {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	mHasPendingPlayback = false;
+	mPlayer.close();
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::isPlaying() const {
+	return mPlayer.isOpen();
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::startMirrorSender(const std::string & host_, int port_, float keyframeInterval_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	stopMirror();
+
+	std::unique_ptr<MirrorSender> sender(new MirrorSender());
+	if (!sender->setup(host_, port_)) {
+		return false;
+	}
+
+	// ----------| invariant: socket is set up
+
+	mMirrorSender = std::move(sender);
+	mMirrorKeyframeInterval_us = uint64_t(std::max(keyframeInterval_, 0.f) * 1e6f);
+	mNextMirrorKeyframe_us = 0; // the first datagram is a keyframe
+	mMirrorSwitches.reserve(NUM_ENCODERS);
+	for (auto & d : mDevices) {
+		d->masks.mirrored = 0;
+	}
+	return true;
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::startMirrorFollower(int port_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	stopMirror();
+
+	std::unique_ptr<MirrorReceiver> receiver(new MirrorReceiver());
+	if (!receiver->setup(port_)) {
+		return false;
+	}
+	mMirrorReceiver = std::move(receiver);
+	return true;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stopMirror() {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+	mMirrorSender.reset();
+	mMirrorReceiver.reset();
+	mMirrorSwitches.clear();
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::mirrorValue(Device & d_, Encoder & e_, uint16_t v_, bool isFine_) {
+	MirrorValue v;
+	v.device = d_.id;
+	v.encoder = e_.pos;
+	v.isFine = isFine_;
+	v.value = v_;
+
+	if (e_.mState == Encoder::State::SWITCH) {
+		// switches are never coalesced, so that a press and release 
+		// within the same frame reach followers, too.
+		mMirrorSwitches.push_back(v);
+		return;
+	}
+
+	// ----------| invariant: rotaries keep the latest value per frame
+
+	d_.mirrorValues[e_.pos] = v;
+	d_.masks.mirrored |= e_.bit();
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::sendMirror(uint64_t now_us_) {
+
+	const bool isKeyframe = now_us_ >= mNextMirrorKeyframe_us;
+
+	const bool hasValues = !mMirrorSwitches.empty() || std::any_of(mDevices.begin(), mDevices.end(), [](const std::unique_ptr<Device>& d) {
+		return d->masks.mirrored != 0;
+	});
+
+	if (!isKeyframe && !hasValues) {
+		// nothing has changed - followers are up to date
+		return;
+	}
+
+	// ----------| invariant: we send a datagram
+
+	if (isKeyframe) {
+		mNextMirrorKeyframe_us = now_us_ + mMirrorKeyframeInterval_us;
+	}
+
+	mMirrorSender->begin(isKeyframe);
+
+	for (auto & d : mDevices) {
+		const bool hasSwitches = std::any_of(mMirrorSwitches.begin(), mMirrorSwitches.end(), [&d](const MirrorValue& v) {
+			return v.device == d->id;
+		});
+
+		// keyframes hold every bound encoder - values applied this 
+		// frame take the place of what the parameter holds, as smoothed
+		// parameters may not have reached them yet.
+		const uint64_t mirrored = d->masks.mirrored;
+		d->masks.mirrored = 0;
+
+		uint64_t encoders = mirrored;
+		if (isKeyframe) {
+			encoders |= d->masks.rotary | d->masks.toggle;
+		}
+
+		if (d->page == nullptr || (encoders == 0 && !hasSwitches && !isKeyframe)) {
+			continue;
+		}
+
+		MirrorDevice md;
+		md.device = d->id;
+		for (size_t i = 0; i < NUM_BANKS; ++i) {
+			md.bankPages[i] = uint16_t(std::min<size_t>(d->bankPages[i], UINT16_MAX));
+		}
+		mMirrorSender->addDevice(md);
+
+		for (size_t i = 0; encoders != 0; ++i, encoders >>= 1) {
+			if ((encoders & 1) == 0) {
+				continue;
+			}
+			auto & e = d->encoders[i];
+			if (mirrored & e.bit()) {
+				const auto & v = d->mirrorValues[i];
+				mMirrorSender->addValue(v.encoder, v.value, v.isFine);
+			} else if (e.mState == Encoder::State::ROTARY) {
+				const float n = (d->masks.smoothing & e.bit()) ? e.mSmoothTarget : e.mBinding->ops->readNormalized(*e.mBinding);
+				mMirrorSender->addValue(e.pos, uint16_t(std::round(n * MirrorValue::FINE_MAX)), true);
+			} else {
+				mMirrorSender->addValue(e.pos, e.mBinding->ops->readValue(*e.mBinding), false);
+			}
+		}
+
+		for (auto & v : mMirrorSwitches) {
+			if (v.device == d->id) {
+				mMirrorSender->addValue(v.encoder, v.value, v.isFine);
+			}
+		}
+	}
+
+	mMirrorSender->end();
+	mMirrorSwitches.clear();
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::receiveMirror() {
+
+	while (mMirrorReceiver->receive(mMirrorFrame)) {
+
+		// pages first, so that values land on the encoders which 
+		// show them on the sender.
+		for (auto & md : mMirrorFrame.devices) {
+			if (md.device >= mDevices.size() || mDevices[md.device]->page == nullptr) {
+				continue;
+			}
+			auto & d = *mDevices[md.device];
+			for (size_t i = 0; i < NUM_BANKS; ++i) {
+				if (d.bankPages[i] != md.bankPages[i]) {
+					d.bankPages[i] = md.bankPages[i];
+					bindBank(d, i);
+				}
+			}
+		}
+
+		for (auto & v : mMirrorFrame.values) {
+			if (v.device >= mDevices.size() || v.encoder >= NUM_ENCODERS) {
+				continue;
+			}
+			auto & d = *mDevices[v.device];
+			auto & e = d.encoders[v.encoder];
+			if (!e.isBound()) {
+				continue;
+			}
+
+			// ----------| invariant: encoder follows a parameter
+
+			if (!v.isFine) {
+				// keyframes repeat what we most likely hold already - 
+				// we only apply what differs, so that listeners stay quiet.
+				if (mMirrorFrame.isKeyframe && e.mBinding->ops->readValue(*e.mBinding) == v.value) {
+					continue;
+				}
+				// unlike input from a device, a twister attached to this 
+				// node doesn't show the value yet - so it must get staged, 
+				// as for any change made on the host.
+				if (e.mState == Encoder::State::ROTARY && mSmoothing != Smoothing::NONE && e.canSmooth()) {
+					e.startSmoothing(v.value / 127.f, steady_clock_us(), false);
+					d.masks.smoothing |= e.bit();
+				} else {
+					e.updateParameter(uint8_t(v.value));
+				}
+				continue;
+			}
+
+			// ----------| invariant: a normalised target, for a rotary
+
+			if (e.mState != Encoder::State::ROTARY) {
+				continue;
+			}
+			const float n = v.value / float(MirrorValue::FINE_MAX);
+			if (mMirrorFrame.isKeyframe && std::fabs(e.mBinding->ops->readNormalized(*e.mBinding) - n) < 0.5f / MirrorValue::FINE_MAX) {
+				continue;
+			}
+			if (mSmoothing != Smoothing::NONE && e.canSmooth()) {
+				e.startSmoothing(n, steady_clock_us(), false);
+				d.masks.smoothing |= e.bit();
+			} else {
+				e.writeNormalized(n);
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::stepPlayback(uint64_t now_us_) {
+
+	const uint64_t elapsed_us = now_us_ - mPlaybackStart_us;
+	MidiRecordingEvent e;
+
+	while (true) {
+		if (mHasPendingPlayback) {
+			e = mPendingPlayback;
+			mHasPendingPlayback = false;
+		} else if (!mPlayer.next(elapsed_us, e)) {
+			break;
+		}
+
+		if (e.device >= mDevices.size()) {
+			continue;
+		}
+
+		// ----------| invariant: e is due, and for a device we have
+
+		MidiInMessage m;
+		m.msg.command_channel = e.status;
+		m.msg.controller = e.controller;
+		m.msg.value = e.value;
+		m.device = e.device;
+		m.deviceTime = e.time_us * 1e-6;
+		// the time the message was due, rather than now - this keeps 
+		// acceleration, which depends on the time between messages, 
+		// the same as when the recording was made.
+		m.received_us = mPlaybackStart_us + e.time_us;
+
+		if (!mMidiInQueue.tryPush(m)) {
+			// we keep what did not fit, and try again next frame, so 
+			// that playback never loses messages.
+			mPendingPlayback = e;
+			mHasPendingPlayback = true;
+			break;
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+const ValueTable & ofxParameterTwister::getValueTable(size_t device_) {
+	if (!mSettings.publishValues) {
+		ofLogWarning() << "value tables only get written if Settings::publishValues is set";
+	}
+
+	if (device_ > UINT8_MAX) {
+		ofLogError() << "cannot get values for device " << device_ << ", device ids are 8 bit";
+		device_ = 0;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	// as with setParams(), asking for a device we haven't seen 
+	// yet reserves it for the next twister found.
+	while (device_ >= mDevices.size()) {
+		addDevice();
+	}
+
+	return mDevices[device_]->values;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::processMessage(const MidiInMessage & m_) {
+
+	++mMessagesIn;
+	auto & d = *mDevices[m_.device];
+	if (handleSystemMessage(d, m_.msg))
+		return;
+
+	// we got a message. 
+	// let's find out which encoder it is for, if any.
+	auto e = encoderForMessage(d, m_.msg);
+	if (e == nullptr)
+		return;
+
+	if (mInputDelivery == InputDelivery::EACH_MESSAGE) {
+		applyMessage(d, *e, m_);
+		recordLatency(m_.received_us, steady_clock_us());
+		return;
+	}
+
+	// ----------| invariant: we collapse all messages received since the 
+	// last frame into the latest value per encoder.
+
+	if (e->mState == Encoder::State::SWITCH) {
+		// switches are never collapsed, as otherwise press and 
+		// release within the same frame would cancel out.
+		applyAbsolute(d, *e, m_.msg.value);
+		recordLatency(m_.received_us, steady_clock_us());
+		return;
+	}
+
+	if ((d.masks.changed & (1ULL << e->pos)) == 0) {
+		d.latestTimes[e->pos] = m_.received_us;
+		d.latestTicks[e->pos] = 0.f;
+	}
+	if (mEncoderMode == EncoderMode::RELATIVE) {
+		// relative values can't be collapsed into the latest
+		// one, they add up.
+		d.latestTicks[e->pos] += e->accelerate(m_.msg.value, m_.received_us, mMaxAcceleration);
+	} else {
+		d.latestValues[e->pos] = m_.msg.value;
+	}
+	d.masks.changed |= (1ULL << e->pos);
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::applyCollapsed() {
+	for (auto & d : mDevices) {
+		uint64_t changed = d->masks.changed;
+		d->masks.changed = 0;
+		for (size_t i = 0; changed != 0; ++i, changed >>= 1) {
+			if (changed & 1) {
+				if (mEncoderMode == EncoderMode::RELATIVE) {
+					applyRelative(*d, d->encoders[i], d->latestTicks[i]);
+				} else {
+					applyAbsolute(*d, d->encoders[i], d->latestValues[i]);
+				}
+				// for collapsed values, we measure the latency of the 
+				// oldest message, as this is the one which waited longest.
+				recordLatency(d->latestTimes[i], steady_clock_us());
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::update() {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	if (FrameProfiler::COMPILED_IN) {
+		// a frame runs from one update() to the next
+		mProfiler.endFrame(getSentCount());
+	}
+	ProfileTimer profile(&mProfiler, ProfileScope::UPDATE);
+
+	updateConnections();
+
+	if (mPlayer.isOpen()) {
+		stepPlayback(steady_clock_us());
+	}
+
+	{
+		ProfileTimer profileDrain(&mProfiler, ProfileScope::INPUT_DRAIN);
+
+		if (mSettings.pollInput) {
+			pollDevices();
+		}
+
+		// messages from all devices arrive in one queue, so 
+		// we drain everything in one pass. with polled input, this
+		// queue only carries messages played back from a recording.
+
+		MidiInMessage m;
+		while (mMidiInQueue.tryPop(m)) {
+			processMessage(m);
+		}
+
+		if (mMirrorReceiver) {
+			receiveMirror();
+		}
+
+		if (mInputDelivery == InputDelivery::LATEST_PER_FRAME) {
+			applyCollapsed();
+		}
+	}
+
+	// outside the drain's scope, so that network time doesn't 
+	// count as the cost of applying input.
+	if (mMirrorSender) {
+		sendMirror(steady_clock_us());
+	}
+
+	stepMorph(steady_clock_us());
+
+	if (!mSmoothingWorker.joinable()) {
+		stepSmoothing(steady_clock_us());
+	}
+
+	if (mSyncMode == SyncMode::POLL) {
+		syncParameters();
+	}
+
+	if (mDetectAnimations) {
+		updateAnimations(steady_clock_us());
+	}
+
+	// send the state which has changed since the last frame - 
+	// this includes any changes caused by setParams, or by 
+	// parameters changing outside of the twister.
+	// encoders only queue the last value per slot, and only if it 
+	// differs from what the device already shows.
+
+	for (auto & d : mDevices) {
+
+		if (d->bankChangePending) {
+			// tell the device to show the bank first, so that it 
+			// shows the state of the bank we are about to send.
+			d->bankChangePending = !d->outQueue.push({
+				0xB3,						// system messages on channel 3
+				uint8_t(d->activeBank),		// bank id
+				127,
+			});
+		}
+
+		// only the visible bank gets sent - other banks keep their 
+		// state dirty until they become visible.
+		const size_t bankBegin = d->activeBank * ENCODERS_PER_BANK;
+		uint64_t dirty = (d->masks.dirty >> bankBegin) & ((1ULL << ENCODERS_PER_BANK) - 1);
+		for (size_t i = bankBegin; dirty != 0; ++i, dirty >>= 1) {
+			if (dirty & 1)
+				d->encoders[i].flush(d->outQueue);
+		}
+		d->outQueue.flush();
+	}
+
+	updateRates(steady_clock_us());
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::handleSystemMessage(Device& d_, const MidiCCMessage & m_) {
+	
+	if (m_.getCommand() != 0xB || m_.getChannel() != 0x3) {
+		return false;
+	}
+
+	// ----------| invariant: this is a CC message on the system channel
+
+	if (m_.controller < NUM_BANKS && m_.value == 127) {
+		// device has switched banks. the newly visible bank's 
+		// state will go out with this frame's flush.
+		d_.activeBank = m_.controller;
+		d_.bankChangePending = false;
+	}
+
+	const size_t numSideButtons = NUM_BANKS * SIDE_BUTTONS_PER_BANK;
+	if (m_.controller >= SIDE_BUTTON_FIRST_CC && m_.controller < SIDE_BUTTON_FIRST_CC + numSideButtons && m_.value == 127 && d_.page != nullptr) {
+		// side button pressed - buttons on the left flip back, buttons 
+		// on the right flip forward. 
+		bool isLeft = (m_.controller - SIDE_BUTTON_FIRST_CC) % SIDE_BUTTONS_PER_BANK < SIDE_BUTTONS_PER_BANK / 2;
+		size_t page = getPage(d_.id);
+		if (isLeft && page > 0) {
+			setPage(page - 1, d_.id);
+		} else if (!isLeft) {
+			setPage(page + 1, d_.id);
+		}
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setBank(size_t bank_, size_t device_) {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	if (bank_ >= NUM_BANKS) {
+		ofLogError() << "cannot switch to bank " << bank_ << ", twister only has " << NUM_BANKS << " banks";
+		return;
+	}
+	if (device_ >= mDevices.size()) {
+		ofLogError() << "cannot switch banks on device " << device_ << ", only " << mDevices.size() << " devices set up";
+		return;
+	}
+
+	// ----------| invariant: bank_ and device_ are valid
+
+	mDevices[device_]->activeBank = bank_;
+	mDevices[device_]->bankChangePending = true;
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::getBank(size_t device_) const {
+	return (device_ < mDevices.size()) ? mDevices[device_]->activeBank : 0;
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::Encoder * ofxParameterTwister::encoderForMessage(Device& d_, const MidiCCMessage & m_) {
+
+	if (m_.getCommand() != 0xB) {
+		return nullptr;
+	}
+
+	// ----------| invariant: this is a CC message.
+	
+	if (m_.controller >= NUM_ENCODERS) {
+		// controller id out of range, ignore
+		return nullptr;
+	}
+
+	// ----------| invariant: controller id is a valid encoder index
+
+	// we decide from the device's masks alone, so that messages 
+	// for disabled encoders never touch the encoder itself.
+	const uint64_t bit = 1ULL << m_.controller;
+
+	if (m_.getChannel() == 0x0 && (d_.masks.rotary & bit)) {
+		// rotary message
+		return &d_.encoders[m_.controller];
+	}
+
+	if (m_.getChannel() == 0x1 && (d_.masks.toggle & bit)) {
+		// switch message
+		return &d_.encoders[m_.controller];
+	}
+
+	return nullptr;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setInputDelivery(InputDelivery mode_) {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	mInputDelivery = mode_;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setSyncMode(SyncMode mode_) {
+
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	if (mode_ == mSyncMode) {
+		return;
+	}
+
+	mSyncMode = mode_;
+
+	// bound encoders swap listeners for polling, or back - and pick 
+	// up whatever changed whilst they weren't following.
+	for (auto & d : mDevices) {
+		for (auto & e : d->encoders) {
+			e.mIsPolled = (mSyncMode == SyncMode::POLL);
+			if (!e.isBound()) {
+				continue;
+			}
+			const Binding & b = *e.mBinding;
+			if (mSyncMode == SyncMode::POLL) {
+				e.mELParamChange = ofEventListener();
+				e.mSyncedValue = b.ops->readValue(b);
+			} else {
+				e.mELParamChange = b.ops->listen(b, e);
+			}
+			e.setValue(b.ops->readValue(b));
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::SyncMode ofxParameterTwister::getSyncMode() const {
+	return mSyncMode;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::syncParameters() {
+	for (auto & d : mDevices) {
+		// encoders which glide towards a value the device shows 
+		// already must not send their steps - they are synced once
+		// they have settled.
+		uint64_t bound = d->masks.rotary | d->masks.toggle;
+		for (size_t i = 0; bound != 0; ++i, bound >>= 1) {
+			if ((bound & 1) == 0) {
+				continue;
+			}
+			auto & e = d->encoders[i];
+			if ((d->masks.smoothing & e.bit()) && e.mSmoothTargetShown) {
+				continue;
+			}
+			e.sync();
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setAnimation(const ofAbstractParameter & param_, Animation animation_, AnimationRate rate_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	auto it = std::find_if(mAnimationFlags.begin(), mAnimationFlags.end(), [&param_](const AnimationFlag& f) {
+		return f.param->isReferenceTo(param_);
+	});
+
+	if (animation_ == Animation::NONE) {
+		if (it != mAnimationFlags.end()) {
+			mAnimationFlags.erase(it);
+		}
+	} else {
+		if (it == mAnimationFlags.end()) {
+			mAnimationFlags.emplace_back();
+			it = std::prev(mAnimationFlags.end());
+			it->param = param_.newReference();
+		}
+		it->animation = animation_;
+		it->rate = rate_;
+	}
+
+	// ----------| invariant: flags are up to date - encoders which 
+	// show param_ right now follow them straight away.
+
+	for (auto & d : mDevices) {
+		uint64_t bound = d->masks.rotary | d->masks.toggle;
+		for (size_t i = 0; bound != 0; ++i, bound >>= 1) {
+			auto & e = d->encoders[i];
+			if ((bound & 1) && e.mBinding->param->isReferenceTo(param_)) {
+				e.setDeviceAnimation(animation_, rate_, false);
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::applyAnimationFlag(Encoder & e_) {
+	if (!e_.isBound()) {
+		return;
+	}
+	for (auto & f : mAnimationFlags) {
+		if (e_.mBinding->param->isReferenceTo(*f.param)) {
+			e_.setDeviceAnimation(f.animation, f.rate, false);
+			return;
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setAnimationDetection(bool enabled_, float bpm_) {
+	std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+	mDetectAnimations = enabled_;
+	mAnimationBpm = bpm_;
+
+	for (auto & d : mDevices) {
+		for (auto & e : d->encoders) {
+			e.mDetectAnimation = enabled_;
+			if (!enabled_ && e.mIsAnimationDetected) {
+				e.setDeviceAnimation(Animation::NONE, AnimationRate::BEATS_1, false);
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::updateAnimations(uint64_t now_us_) {
+
+	// a pattern must hold for this many events before we hand it 
+	// to the device - and the device hands it back once an event is 
+	// overdue by more than this many periods.
+	static const uint8_t STABLE_EVENTS = 4;
+	static const float TIMEOUT_PERIODS = 2.5f;
+
+	// length of a beat, at the device's tempo
+	const float beat_us = 60.e6f / std::max(mAnimationBpm, 1.f);
+
+	for (auto & d : mDevices) {
+		uint64_t bound = d->masks.rotary | d->masks.toggle;
+		for (size_t i = 0; bound != 0; ++i, bound >>= 1) {
+			if ((bound & 1) == 0) {
+				continue;
+			}
+			auto & e = d->encoders[i];
+			auto & p = e.mDetector;
+
+			if (e.mAnimation == Animation::NONE) {
+				if (p.stableEvents < STABLE_EVENTS) {
+					continue;
+				}
+
+				// a rate is the length of one flash, or pulse - switches 
+				// take two toggles for one flash. rates halve from 8 
+				// beats, so the closest one is the closest power of two.
+				const bool isSwitch = e.mState == Encoder::State::SWITCH;
+				const float beats = (isSwitch ? 2.f : 1.f) * p.period_us / beat_us;
+				const int rate = int(std::round(std::log2(8.f / beats)));
+				if (rate < 0 || rate > int(AnimationRate::BEATS_1_16)) {
+					// too slow, or too fast, for the device
+					continue;
+				}
+				const Animation a = isSwitch ? Animation::STROBE : Animation::PULSE;
+				e.setDeviceAnimation(a, AnimationRate(rate), true);
+
+			} else if (e.mIsAnimationDetected) {
+				const bool isOverdue = float(now_us_ - p.lastEvent_us) > TIMEOUT_PERIODS * p.period_us;
+				if (p.stableEvents < STABLE_EVENTS || isOverdue) {
+					// the pattern broke, or has stopped - we must see 
+					// it again from the start before animating again.
+					p.stableEvents = 0;
+					e.setDeviceAnimation(Animation::NONE, AnimationRate::BEATS_1, false);
+				}
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+uint64_t ofxParameterTwister::getInputOverflowCount() const {
+	return mMidiInQueue.getOverflowCount();
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::getOutputQueueDepth() const {
+	size_t depth = 0;
+	for (auto & d : mDevices) {
+		depth += d->outQueue.size();
+	}
+	return depth;
+}
+
+// ------------------------------------------------------
+
+uint32_t ofxParameterTwister::getWorstSendLatencyMicros() const {
+	uint32_t worst = 0;
+	for (auto & d : mDevices) {
+		worst = std::max(worst, d->outQueue.getWorstLatencyMicros());
+	}
+	return worst;
+}
+
+// ------------------------------------------------------
+
+uint64_t ofxParameterTwister::getSentCount() const {
+	uint64_t sent = 0;
+	for (auto & d : mDevices) {
+		sent += d->outQueue.getSentCount();
+	}
+	return sent;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::recordLatency(uint64_t received_us_, uint64_t now_us_) {
+	uint64_t latency = (now_us_ > received_us_) ? now_us_ - received_us_ : 0;
+	mLatencyHistogram.record(uint32_t(std::min<uint64_t>(latency, UINT32_MAX)));
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::updateRates(uint64_t now_us_) {
+	
+	if (mRateWindowStart_us == 0) {
+		mRateWindowStart_us = now_us_;
+		mRateWindowIn = mMessagesIn;
+		mRateWindowOut = getSentCount();
+		return;
+	}
+
+	// ----------| invariant: rate window has been started
+
+	uint64_t elapsed = now_us_ - mRateWindowStart_us;
+	
+	if (elapsed < 1000000) {
+		return;
+	}
+
+	// ----------| invariant: at least one second has passed
+
+	uint64_t sent = getSentCount();
+	double seconds = double(elapsed) / 1000000.0;
+	mRateIn = float(double(mMessagesIn - mRateWindowIn) / seconds);
+	mRateOut = float(double(sent - mRateWindowOut) / seconds);
+
+	mRateWindowStart_us = now_us_;
+	mRateWindowIn = mMessagesIn;
+	mRateWindowOut = sent;
+}
+
+// ------------------------------------------------------
+
+ofxParameterTwister::Stats ofxParameterTwister::getStats() const {
+	Stats s;
+	s.latencyP50_us = mLatencyHistogram.percentile(0.50);
+	s.latencyP99_us = mLatencyHistogram.percentile(0.99);
+	s.latencyMax_us = mLatencyHistogram.max();
+	s.messagesInPerSecond = mRateIn;
+	s.messagesOutPerSecond = mRateOut;
+	s.messagesIn = mMessagesIn;
+	s.messagesOut = getSentCount() - mMessagesOutBase;
+	s.inputQueueHighWater = mMidiInQueue.getHighWaterMark();
+	for (auto & d : mDevices) {
+		s.outputQueueHighWater = std::max(s.outputQueueHighWater, d->outQueue.getHighWaterMark());
+	}
+	s.inputOverflowCount = mMidiInQueue.getOverflowCount();
+	return s;
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::resetStats() {
+	mLatencyHistogram.reset();
+	mMessagesIn = 0;
+	mMessagesOutBase = getSentCount();
+	mMidiInQueue.resetHighWaterMark();
+	for (auto & d : mDevices) {
+		d->outQueue.resetHighWaterMark();
+		d->outQueue.resetWorstLatency();
+	}
+	
+	// restart rate window
+	mRateWindowStart_us = 0;
+}
+
+// ------------------------------------------------------
+
+bool ofxParameterTwister::checkMapping(const MfsMapping & mapping_) const {
+	auto problems = mapping_.validate(mEncoderMode == EncoderMode::RELATIVE);
+	for (auto & p : problems) {
+		ofLogWarning() << "twister mapping: " << p;
+	}
+	return problems.empty();
+}
+
+// ------------------------------------------------------
+
+void ofxParameterTwister::setTraceEnabled(bool enabled_) {
+	if (enabled_ && !MidiTrace::COMPILED_IN) {
+		ofLogWarning() << "midi tracing requested, but not compiled in. Define OFX_PARAMETER_TWISTER_TRACE=1 to enable.";
+	}
+	mTrace.setEnabled(enabled_);
+}
+
+// ------------------------------------------------------
+
+size_t ofxParameterTwister::dumpTrace(std::ostream & stream_) {
+	return mTrace.dump(stream_);
+}
+
+// ------------------------------------------------------
+
+const FrameReport & ofxParameterTwister::getFrameReport() const {
+	return mProfiler.getLastFrame();
+}
+
 // ------------------------------------------------------
-/// \brief		static callback for midi controller
-/// \detail		all this callback does is translate the message into a midi messge object
-/// and then pass is on to a the midi in thread channel
-/// so it can be processed in update.
-void _midi_callback(double deltatime, std::vector< unsigned char > *message, void *threadChannel)
-{
-	unsigned int nBytes = message->size();
 
-	auto tCh = static_cast<ofThreadChannel<MidiCCMessage>*>(threadChannel);
+size_t MidiTrace::dump(std::ostream & stream_) {
+	
+	// we merge both rings by timestamp - each ring is 
+	// already in chronological order.
+
+	Record rIn, rOut;
+	bool hasIn = mIn.tryPop(rIn);
+	bool hasOut = mOut.tryPop(rOut);
+	size_t count = 0;
+
+	std::ios::fmtflags flags(stream_.flags());
+
+	while (hasIn || hasOut) {
+		bool takeIn = hasIn && (!hasOut || rIn.timestamp_us <= rOut.timestamp_us);
+		const Record& r = takeIn ? rIn : rOut;
+
+		stream_
+			<< std::dec << std::setw(14) << r.timestamp_us << " "
+			<< std::setw(3) << 1 * r.device << " "
+			<< (takeIn ? "<<" : ">>") << " "
+			<< std::hex << std::setfill('0')
+			<< std::setw(2) << 1 * r.msg.command_channel << " "
+			<< std::setw(2) << 1 * r.msg.controller << " "
+			<< std::setw(2) << 1 * r.msg.value
+			<< std::setfill(' ') << std::endl;
+		++count;
+
+		if (takeIn) {
+			hasIn = mIn.tryPop(rIn);
+		} else {
+			hasOut = mOut.tryPop(rOut);
+		}
+	}
 
-	// message will come in three bytes, with the first byte == 176.
+	stream_.flags(flags);
+	return count;
+}
 
-	if (message->size() == 3) {
+// ------------------------------------------------------
 
-		MidiCCMessage msg;
-		msg.command_channel = message->at(0);
-		msg.controller = message->at(1);
-		msg.value = message->at(2);
+bool MidiOutQueue::push(const MidiCCMessage & msg_) {
+	Pending p;
+	p.msg = msg_;
+	p.queued_us = uint32_t(steady_clock_us());
 
-		ostringstream ostr;
-		ostr
-			<< std::hex << 1 * msg.getCommand() << " : "
-			<< std::hex << 1 * msg.getChannel() << " : "
-			<< std::hex << 1 * msg.controller << " : "
-			<< std::hex << 1 * msg.value;
+	if (mRing.tryPush(p)) {
+		return true;
+	}
 
-		ofLogVerbose() << ostr.str();
+	// ----------| invariant: ring is full
 
-		tCh->send(std::move(msg));
+	if (isThreaded()) {
+		// the sender thread is behind - caller must try again later.
+		return false;
 	}
+
+	// we must not drop messages, as this would leave the device 
+	// in an inconsistent state, so we send everything queued so 
+	// far straight away.
+	flush();
+	return mRing.tryPush(p);
 }
 
 // ------------------------------------------------------
 
-ofxParameterTwister::~ofxParameterTwister() {
-	if (mMidiIn != nullptr) {
-		mMidiIn->closePort();
-		delete mMidiIn;
-		mMidiIn = nullptr;
-	}
-	if (mMidiOut != nullptr) {
-		mMidiOut->closePort();
-		delete mMidiOut;
-		mMidiOut = nullptr;
+void MidiOutQueue::flush() {
+
+	if (isThreaded()) {
+		// taking the lock makes sure the sender thread can't miss
+		// this wakeup between checking the ring and going to sleep.
+		{
+			std::lock_guard<std::mutex> lock(mWakeMutex);
+		}
+		mWakeCondition.notify_one();
+		return;
 	}
+
+	// ----------| invariant: we are not threaded, so we send from here
+
+	while (sendBatch(MAX_BATCH_MESSAGES) > 0) {};
 }
 
 // ------------------------------------------------------
 
-void ofxParameterTwister::setup() {
+size_t MidiOutQueue::sendBatch(size_t maxMessages_) {
+	
+	std::lock_guard<std::mutex> lock(mPortMutex);
 
-	// establish midi in connection,
-	// and bind callback for midi in.
-	try {
-		mMidiIn = new RtMidiIn();
-		size_t numPorts = mMidiIn->getPortCount();
-		size_t midiPort = -1;
-		const std::string deviceName("Midi Fighter Twister");
-		if (mMidiIn->getPortCount() >= 1)
-		{
-			for (size_t i = 0; i < numPorts; ++i)
-			{
-				if (mMidiIn->getPortName(i).substr(0, deviceName.size()) == deviceName)
-				{
-					midiPort = i;
-					mMidiIn->openPort(midiPort);
-					mMidiIn->setCallback(&_midi_callback, &mChannelMidiIn);
+	const size_t limit = std::min(maxMessages_, mCanBatch ? MAX_BATCH_MESSAGES : 1);
 
-					// Don't ignore sysex, timing, or active sensing messages.
-					mMidiIn->ignoreTypes(true, true, true);
-				}
-			}
-		}
+	size_t n = 0;
+	while (n < limit && mRing.tryPop(mBatch[n])) {
+		++n;
 	}
-	catch (RtMidiError &error)
-	{
-		std::cout << "MIDI input exception:" << std::endl;
-		error.printMessage();
+
+	if (n == 0 || mMidiOut == nullptr) {
+		// nothing to send, or no device to send to - 
+		// messages are discarded
+		return n;
 	}
 
-	// establish midi out connection
+	// ----------| invariant: midiOut is not nullptr, and can't go away whilst we send
+
 	try {
-		mMidiOut = new RtMidiOut();
-		size_t numPorts = mMidiOut->getPortCount();
-		size_t midiPort = -1;
-		const std::string deviceName("Midi Fighter Twister");
-		if (mMidiOut->getPortCount() >= 1)
-		{
-			for (size_t i = 0; i < numPorts; ++i)
-			{
-				if (mMidiOut->getPortName(i).substr(0, deviceName.size()) == deviceName)
-				{
-					midiPort = i;
-					mMidiOut->openPort(midiPort);
-				}
+		if (n == 1) {
+			const auto & msg = mBatch[0].msg;
+			mMidiOut->sendShortMessage(msg.command_channel, msg.controller, msg.value);
+		} else {
+			// complete messages, back to back - we don't use running status,
+			// as CoreMIDI does not allow it within packets.
+			mScratch.resize(3 * n); // never allocates: capacity is reserved for the largest batch
+			for (size_t i = 0; i < n; ++i) {
+				mScratch[3 * i + 0] = mBatch[i].msg.command_channel;
+				mScratch[3 * i + 1] = mBatch[i].msg.controller;
+				mScratch[3 * i + 2] = mBatch[i].msg.value;
 			}
+			mMidiOut->sendMessage(&mScratch);
 		}
 	}
-	catch (RtMidiError &error)
-	{
-		std::cout << "MIDI output exception:" << std::endl;
-		error.printMessage();
+	catch (RtMidiError &error) {
+		// the messages are lost, but we don't want to resend them forever.
+		// we only report the first failure, as the device has most 
+		// likely gone, and will be re-connected.
+		if (!mSendFailed.exchange(true)) {
+			std::cout << "MIDI output exception:" << std::endl;
+			error.printMessage();
+		}
+		return n;
 	}
 
-	// assign ids to encoders
-	for (int i = 0; i < 16; ++i) {
-		mEncoders[i].pos = i;
-		mEncoders[i].mMidiOut = mMidiOut;
-	};
+	mSentCount.fetch_add(n, std::memory_order_relaxed);
+
+	const uint32_t now_us = uint32_t(steady_clock_us());
+	uint32_t worst = mWorstLatency_us.load(std::memory_order_relaxed);
+
+	for (size_t i = 0; i < n; ++i) {
+		if (mTrace != nullptr)
+			mTrace->traceOut(mBatch[i].msg, mDevice);
+
+		uint32_t latency = now_us - mBatch[i].queued_us; // wraps around safely
+		while (latency > worst &&
+			!mWorstLatency_us.compare_exchange_weak(worst, latency, std::memory_order_relaxed)) {
+		};
+	}
+
+	return n;
 }
 
 // ------------------------------------------------------
 
+void MidiOutQueue::startSenderThread(float messagesPerMs_) {
+	if (isThreaded()) {
+		return;
+	}
+
+	// ----------| invariant: no sender thread running yet
+
+	mMessagesPerMs = messagesPerMs_;
+	mShouldRun = true;
+	mSenderThread = std::thread(&MidiOutQueue::senderThreadFunction, this);
+}
 
 // ------------------------------------------------------
 
-void ofxParameterTwister::setParams(const ofParameterGroup& group_)
-{
-	ofLogVerbose() << "Updating mapping" << endl;
-	/*
+void MidiOutQueue::stopSenderThread() {
+	if (!isThreaded()) {
+		return;
+	}
 
-	based on incoming parameters,
-	we set our Encoders to track them
+	// ----------| invariant: sender thread is running
 
-	*/
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mShouldRun = false;
+	}
+	mWakeCondition.notify_one();
+	mSenderThread.join();
+}
 
-	auto it = group_.begin();
-	auto endIt = group_.end();
+// ------------------------------------------------------
 
-	for (auto & e : mEncoders) {
+void MidiOutQueue::senderThreadFunction() {
+	
+	typedef std::chrono::steady_clock clock;
+	typedef std::chrono::duration<double, std::milli> ms;
+
+	// token bucket: we earn mMessagesPerMs tokens per millisecond, 
+	// and every message sent costs one token. the bucket holds at 
+	// most one millisecond's worth of tokens, so that bursts after 
+	// idle periods are bounded too.
+	const bool isPaced = mMessagesPerMs > 0.f;
+	const double bucketSize = std::max(1.0, double(mMessagesPerMs));
+	double tokens = bucketSize;
+	auto lastRefill = clock::now();
+
+	while (mShouldRun) {
+
+		if (mRing.empty()) {
+			// nothing to send - sleep until flush() wakes us up.
+			std::unique_lock<std::mutex> lock(mWakeMutex);
+			mWakeCondition.wait(lock, [this] { return !mShouldRun || !mRing.empty(); });
+			continue;
+		}
 
-		if (it != endIt) {
-			if (auto param = dynamic_pointer_cast<ofParameter<float>>(*it)) {
-				// bingo, we have a float param
-				e.setState(Encoder::State::ROTARY);
-				e.setValue(ofMap(*param, param->getMin(), param->getMax(), 0, 127, true));
+		// ----------| invariant: we have at least one message to send
 
-				// now set the Encoder's event listener to track 
-				// this parameter
-				auto pMin = param->getMin();
-				auto pMax = param->getMax();
+		size_t maxMessages = MAX_BATCH_MESSAGES;
 
-				e.updateParameter = [=](uint8_t v_) {
-					// on midi input
-					param->set(ofMap(v_, 0, 127, pMin, pMax, true));
-				};
+		if (isPaced) {
+			auto now = clock::now();
+			tokens = std::min(bucketSize, tokens + ms(now - lastRefill).count() * mMessagesPerMs);
+			lastRefill = now;
 
-				e.mELParamChange = param->newListener([&e, pMin, pMax](float v_) {
-					// on parameter change, write from parameter 
-					// to midi.
-					e.setValue(ofMap(v_, pMin, pMax, 0, 127, true));
-				});
+			if (tokens < 1.0) {
+				// wait until we have earned the token for the next message
+				std::this_thread::sleep_for(ms((1.0 - tokens) / mMessagesPerMs));
+				now = clock::now();
+				tokens = std::min(bucketSize, tokens + ms(now - lastRefill).count() * mMessagesPerMs);
+				lastRefill = now;
+			}
 
-			} else if (auto param = dynamic_pointer_cast<ofParameter<bool>>(*it)) {
-				// we have a bool parameter
-				e.setState(Encoder::State::SWITCH);
-				e.setValue((*param == true) ? 127 : 0);
-				
-				e.updateParameter = [=](uint8_t v_) {
-					param->set((v_ > 63) ? true : false);
-				};
-
-				e.mELParamChange = param->newListener([&e](bool v_) {
-					e.setValue(v_ == true ? 127 : 0);
-				});
+			// a batch may only spend the tokens we have.
+			maxMessages = std::max<size_t>(1, size_t(tokens));
+		}
 
-			} else {
-				// we cannot match this parameter, unfortunately
-				e.setState(Encoder::State::DISABLED);
-				e.mELParamChange = ofEventListener(); // reset listener
+		tokens -= double(sendBatch(maxMessages));
+	}
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::stage(OutSlot slot_, uint8_t v_)
+{
+	mShadow.target[slot_] = v_;
+	
+	if (mShadow.sent[slot_] != v_) {
+		mShadow.dirty |= (1 << slot_);
+		mMasks->dirty |= bit();
+	} else {
+		// value has returned to what the device already shows
+		mShadow.dirty &= ~(1 << slot_);
+		if (mShadow.dirty == 0)
+			mMasks->dirty &= ~bit();
+	}
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::invalidateShadow()
+{
+	for (uint8_t i = 0; i < OUT_COUNT; ++i) {
+		mShadow.sent[i] = Shadow::UNKNOWN;
+		mShadow.dirty |= (1 << i);
+	}
+	if (mAnimation == Animation::NONE) {
+		// a device animation is only ever sent whilst one runs - 
+		// otherwise, the device is off already.
+		mShadow.dirty &= ~(1 << OUT_DEVICE_ANIMATION);
+	}
+	mMasks->dirty |= bit();
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::flush(MidiOutQueue& queue_)
+{
+	// midi channel for each slot, see OutSlot.
+	static const uint8_t slotCommand[OUT_COUNT] = { 0xB2, 0xB1, 0xB0, 0xB2, 0xB2, 0xB2 };
+
+	for (uint8_t i = 0; i < OUT_COUNT; ++i) {
+		if (mShadow.dirty & (1 << i)) {
+			bool wasQueued = queue_.push({
+				slotCommand[i],
+				pos,					// device id
+				mShadow.target[i],		// value
+			});
+
+			if (!wasQueued) {
+				// queue is full, the remaining slots stay 
+				// dirty, and we'll try again next frame.
+				return;
 			}
-			
-			it++;
 
-		} else {
-			// no more parameters to map.
-			e.setState(Encoder::State::DISABLED, true);
+			mShadow.sent[i] = mShadow.target[i];
+			mShadow.dirty &= ~(1 << i);
 		}
 	}
 
+	mMasks->dirty &= ~bit();
 }
 
 // ------------------------------------------------------
 
-void ofxParameterTwister::update() {
+void pal::Kontrol::ofxParameterTwister::Encoder::bind(const Binding * b_, bool listen_)
+{
+	// drop any listener first, so that it can't fire whilst 
+	// the encoder is half re-bound.
+	mELParamChange = ofEventListener();
+
+	// an animation belongs to the parameter shown so far - the 
+	// twister starts it again, if the new parameter has one. if we
+	// get bound to the very same parameter, it just keeps running.
+	const bool isSameParameter = b_ != nullptr && isBound()
+		&& b_->component == mBinding->component
+		&& b_->param->isReferenceTo(*mBinding->param);
+
+	if (!isSameParameter) {
+		setDeviceAnimation(Animation::NONE, AnimationRate::BEATS_1, false);
+		mDetector = PeriodDetector();
+	}
 
-	MidiCCMessage m;
+	mBinding = b_;
+	mIsSmoothing = false;
+	mIsPolled = !listen_;
 
-	while (mChannelMidiIn.tryReceive(m)) {
+	if (b_ == nullptr) {
+		setState(State::DISABLED);
+		return;
+	}
 
-		// we got a message.
-		
-		// let's get the address.
+	// ----------| invariant: we have a binding
 
-		if (m.getCommand() == 0xB) {
+	// relative position gets picked up from the parameter on next delta
+	mLastWritten = -1.f;
 
-			if (m.getChannel() == 0x0) {
-				// rotary message
-				size_t encoderID = m.controller;
-				auto &e = mEncoders[encoderID];
-				if (e.mState == Encoder::State::ROTARY)
-					if (e.updateParameter)
-						e.updateParameter(m.value);
-			}
+	setState(b_->state);
+	mSyncedValue = b_->ops->readValue(*b_);
+	setValue(mSyncedValue);
+	if (listen_) {
+		mELParamChange = b_->ops->listen(*b_, *this);
+	}
+}
 
-			if (m.getChannel() == 0x1) {
-				// rotary message
-				size_t encoderID = m.controller;
-				auto &e = mEncoders[encoderID];
-				if (e.mState == Encoder::State::SWITCH)
-					if (e.updateParameter)
-						e.updateParameter(m.value);
-			}
-		}
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::sync()
+{
+	if (!isBound()) {
+		return;
+	}
+	const uint8_t v = mBinding->ops->readValue(*mBinding);
+	if (v != mSyncedValue) {
+		mSyncedValue = v;
+		setValue(v);
 	}
 }
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setState(State s_, bool force_)
+bool pal::Kontrol::ofxParameterTwister::Encoder::isBound() const
+{
+	return mBinding != nullptr && mBinding->ops != nullptr;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::updateParameter(uint8_t v_)
+{
+	if (isBound()) {
+		mBinding->ops->updateParameter(*mBinding, v_);
+		syncWritten();
+	}
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::syncWritten()
+{
+	if (!mIsPolled) {
+		return;
+	}
+
+	// ----------| invariant: nothing listens to the parameter
+
+	// whilst applying input, setValue() sends nothing - the device
+	// shows the value already. otherwise, e.g. for relative encoders,
+	// the change is staged just as a listener would have.
+	mSyncedValue = mBinding->ops->readValue(*mBinding);
+	setValue(mSyncedValue);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::receive(uint8_t v_)
+{
+	OutSlot slot = (mState == State::SWITCH) ? OUT_SWITCH : OUT_ROTARY;
+	
+	// anything we had staged for this slot is stale now - 
+	// the device's value is newer.
+	mShadow.sent[slot] = v_;
+	stage(slot, v_);
+}
+
+// ------------------------------------------------------
+
+float pal::Kontrol::ofxParameterTwister::Encoder::accelerate(uint8_t v_, uint64_t received_us_, float maxAcceleration_)
+{
+	// ticks further apart than SLOW_us get no acceleration, 
+	// ticks closer together than FAST_us get full acceleration.
+	static const float SLOW_us = 60000.f;
+	static const float FAST_us = 5000.f;
+
+	float delta = float(int(v_) - 64);
+	float dt = float(received_us_ - mLastTick_us);
+	mLastTick_us = received_us_;
+
+	float t = ofClamp((SLOW_us - dt) / (SLOW_us - FAST_us), 0.f, 1.f);
+
+	return delta * (1.f + (maxAcceleration_ - 1.f) * t);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::nudgeParameter(float ticks_, float range_)
 {
-	if (s_ == mState && force_ == false) {
+	if (!canSmooth()) {
 		return;
 	}
 
-	// ----------| invariant: state change requested, or forced
+	// ----------| invariant: binding supports relative changes
+
+	writeNormalized(advanceRelative(ticks_, range_));
+}
+
+// ------------------------------------------------------
+
+float pal::Kontrol::ofxParameterTwister::Encoder::advanceRelative(float ticks_, float range_)
+{
+	float current = mBinding->ops->readNormalized(*mBinding);
+	
+	if (current != mLastWritten) {
+		// parameter has changed since we last wrote it - 
+		// we continue from wherever it is now.
+		mPosition = current;
+	}
+
+	mPosition = std::min(1.0, std::max(0.0, mPosition + double(ticks_) * range_ / 128.0));
+	return float(mPosition);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::writeNormalized(float n_)
+{
+	mBinding->ops->setNormalized(*mBinding, n_);
+	
+	// the parameter may round, so we keep what it actually holds.
+	mLastWritten = mBinding->ops->readNormalized(*mBinding);
+	syncWritten();
+}
+
+// ------------------------------------------------------
+
+bool pal::Kontrol::ofxParameterTwister::Encoder::canSmooth() const
+{
+	return isBound() && mBinding->ops->setNormalized != nullptr && mBinding->ops->readNormalized != nullptr;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::startSmoothing(float target_, uint64_t now_us_, bool targetShown_)
+{
+	if (!mIsSmoothing) {
+		// we start from wherever the parameter is now
+		mSmoothValue = mBinding->ops->readNormalized(*mBinding);
+		mSmoothVelocity = 0.f;
+		mSmoothLast_us = now_us_;
+		mLastWritten = mSmoothValue;
+		mIsSmoothing = true;
+	}
+	mSmoothTarget = target_;
+	mSmoothTargetShown = targetShown_;
+}
+
+// ------------------------------------------------------
+
+bool pal::Kontrol::ofxParameterTwister::Encoder::stepSmoothing(Smoothing mode_, float time_, uint64_t now_us_)
+{
+	// threshold below which a parameter counts as settled - 
+	// well below a step of the twister's 7 bit values.
+	static const float EPSILON = 1e-4f;
+
+	// a long gap between steps must not make us jump past the target.
+	float dt = std::min(0.1f, float(now_us_ - mSmoothLast_us) * 1e-6f);
+	mSmoothLast_us = now_us_;
+
+	float current = mBinding->ops->readNormalized(*mBinding);
+	if (current != mLastWritten) {
+		// parameter has been changed from elsewhere - we 
+		// continue from there.
+		mSmoothValue = current;
+	}
+
+	if (mode_ == Smoothing::ONE_POLE) {
+		mSmoothValue += (mSmoothTarget - mSmoothValue) * (1.f - std::exp(-dt / time_));
+	} else {
+		// critically damped spring, with the usual polynomial
+		// approximation for exp(-omega * dt).
+		float omega = 2.f / time_;
+		float x = omega * dt;
+		float decay = 1.f / (1.f + x + 0.48f * x * x + 0.235f * x * x * x);
+		float change = mSmoothValue - mSmoothTarget;
+		float temp = (mSmoothVelocity + omega * change) * dt;
+		mSmoothVelocity = (mSmoothVelocity - omega * temp) * decay;
+		mSmoothValue = mSmoothTarget + (change + temp) * decay;
+	}
+
+	bool hasSettled = std::abs(mSmoothTarget - mSmoothValue) < EPSILON && std::abs(mSmoothVelocity) * time_ < EPSILON;
+
+	if (hasSettled) {
+		mSmoothValue = mSmoothTarget;
+		mSmoothVelocity = 0.f;
+		mIsSmoothing = false;
+	}
+
+	mIsApplyingInput = mSmoothTargetShown;
+	writeNormalized(mSmoothValue);
+	mIsApplyingInput = false;
+	return !hasSettled;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::setState(State s_, bool force_)
+{
+	// we always stage the full device state for the requested state - 
+	// the shadow makes sure only what differs from the device gets sent.
+	// this also means the first state set after startup reaches the 
+	// device, as the shadow starts out unknown.
+
+	if (force_) {
+		// we can't be sure what the device shows, so we 
+		// must make sure all slots are sent again.
+		invalidateShadow();
+	}
 
 	switch (s_)
 	{
@@ -261,12 +2920,35 @@ void pal::Kontrol::ofxParameterTwister::Encoder::setState(State s_, bool force_)
 	}
 
 	mState = s_;
+
+	mMasks->rotary &= ~bit();
+	mMasks->toggle &= ~bit();
+	if (s_ == State::ROTARY)
+		mMasks->rotary |= bit();
+	else if (s_ == State::SWITCH)
+		mMasks->toggle |= bit();
 }
 
 // ------------------------------------------------------
 
 void pal::Kontrol::ofxParameterTwister::Encoder::setValue(uint8_t v_) {
 
+	if (mIsApplyingInput) {
+		// change came from the device, which shows it already - 
+		// see receive().
+		return;
+	}
+
+	if (mDetectAnimation && mState != State::DISABLED) {
+		detect(v_, steady_clock_us());
+	}
+
+	if (mAnimation != Animation::NONE) {
+		// the device animates this encoder, and we leave it to it - 
+		// the value is shown again once the animation stops.
+		return;
+	}
+
 	switch (mState)
 	{
 	case pal::Kontrol::ofxParameterTwister::Encoder::State::DISABLED:
@@ -287,98 +2969,136 @@ void pal::Kontrol::ofxParameterTwister::Encoder::setValue(uint8_t v_) {
 // ------------------------------------------------------
 
 void pal::Kontrol::ofxParameterTwister::Encoder::sendToSwitch(uint8_t v_) {
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
-	vector<unsigned char> msg{
-		0xB1,					// SWITCH listens on channel 1
-		pos,					// device id
-		v_,						// value
-	};
-	mMidiOut->sendMessage(&msg);
-
-	ofLogVerbose() << ">>" << setw(2) << 1 * pos << " SWI " << " : " << setw(3) << v_ * 1;
+	ProfileTimer profile(mProfiler, ProfileScope::ENCODER_SEND);
+	// SWITCH listens on channel 1
+	stage(OUT_SWITCH, v_);
 }
 
 // ------------------------------------------------------
 
 void pal::Kontrol::ofxParameterTwister::Encoder::sendToRotary(uint8_t v_) {
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
-	vector<unsigned char> msg{
-		0xB0,					// ROTARY listens on channel 0
-		pos,					// device id
-		v_,						// value
-	};
-
-	mMidiOut->sendMessage(&msg);
-
-	ofLogVerbose() << ">>" << setw(2) << 1 * pos << " ROT " << " : " << setw(3) << v_ * 1;
+	ProfileTimer profile(mProfiler, ProfileScope::ENCODER_SEND);
+	// ROTARY listens on channel 0
+	stage(OUT_ROTARY, v_);
 }
 
 // ------------------------------------------------------
 
 void pal::Kontrol::ofxParameterTwister::Encoder::setBrightnessRotary(float b_)
 {
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
 	unsigned char val = std::roundf(ofMap(b_, 0.f, 1.f, 65, 95, true));
 	
-	vector<unsigned char> msg{
-		0xB2,					// animation control channel 2
-		pos,					// device id
-		val,
-	};
+	// animation control channel 2
+	stage(OUT_BRIGHTNESS_ROTARY, val);
+}
+
+// ------------------------------------------------------
 
-	mMidiOut->sendMessage(&msg);
+void pal::Kontrol::ofxParameterTwister::Encoder::setBrightnessRGB(float b_)
+{
+	unsigned char val = std::roundf(ofMap(b_, 0.f, 1.f, 17, 47, true));
 
+	// animation control channel 2
+	stage(OUT_BRIGHTNESS_RGB, val);
 }
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setBrightnessRGB(float b_)
+void pal::Kontrol::ofxParameterTwister::Encoder::setEncoderAnimation(uint8_t v_)
+{
+	// animation control channel 2
+	stage(OUT_ANIMATION, v_);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::ofxParameterTwister::Encoder::setDeviceAnimation(Animation a_, AnimationRate rate_, bool detected_)
 {
-	if (mMidiOut == nullptr)
+	if (!isBound() || mState == State::DISABLED) {
+		a_ = Animation::NONE;
+	}
+
+	if (a_ == mAnimation && (a_ == Animation::NONE || rate_ == mAnimationRate)) {
+		mIsAnimationDetected = detected_;
 		return;
+	}
 
-	// ----------| invariant: midiOut is not nullptr
+	// ----------| invariant: animation changes
 
-	unsigned char val = std::roundf(ofMap(b_, 0.f, 1.f, 17, 47, true));
+	// on channel 2, rotaries animate their indicator ring: 48 is off,
+	// 49..56 strobe, 57..64 pulse - switches their RGB LED: 0 is off, 
+	// 1..8 strobe, 9..16 pulse. rates go from slowest to fastest.
+	const uint8_t off = (mState == State::ROTARY) ? 48 : 0;
 
-	vector<unsigned char> msg{
-		0xB2,					// animation control channel 2 
-		pos,					// device id
-		val,
-	};
+	const bool wasAnimated = mAnimation != Animation::NONE;
+	mAnimation = a_;
+	mAnimationRate = rate_;
+	mIsAnimationDetected = detected_;
+
+	if (a_ != Animation::NONE) {
+		const uint8_t first = (a_ == Animation::STROBE) ? 1 : 9;
+		stage(OUT_DEVICE_ANIMATION, uint8_t(off + first + uint8_t(rate_)));
+		return;
+	}
+
+	if (!wasAnimated) {
+		return;
+	}
+
+	// ----------| invariant: animation stops
 
-	mMidiOut->sendMessage(&msg);
+	stage(OUT_DEVICE_ANIMATION, off);
+
+	// the device falls back to brightness levels of its own - we 
+	// make sure ours reach it again, and so does the value.
+	for (auto slot : { OUT_BRIGHTNESS_ROTARY, OUT_BRIGHTNESS_RGB }) {
+		mShadow.sent[slot] = Shadow::UNKNOWN;
+		stage(slot, mShadow.target[slot]);
+	}
+	mShadow.sent[(mState == State::ROTARY) ? OUT_ROTARY : OUT_SWITCH] = Shadow::UNKNOWN;
 
+	mSyncedValue = mBinding->ops->readValue(*mBinding);
+	setValue(mSyncedValue);
 }
-// ------------------------------------------------------
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setEncoderAnimation(uint8_t v_)
+void pal::Kontrol::ofxParameterTwister::Encoder::detect(uint8_t v_, uint64_t now_us_)
 {
-	if (mMidiOut == nullptr)
+	auto & d = mDetector;
+
+	if (v_ == d.lastValue) {
 		return;
+	}
 
-	// ----------| invariant: midiOut is not nullptr
+	// switches count each toggle, rotaries each peak - where a 
+	// rising value starts to fall again.
+	bool isEvent = true;
+	if (mState == State::ROTARY) {
+		const int8_t direction = (d.lastValue == Shadow::UNKNOWN || v_ > d.lastValue) ? 1 : -1;
+		isEvent = (d.direction > 0 && direction < 0);
+		d.direction = direction;
+	}
+	d.lastValue = v_;
 
-	vector<unsigned char> msg{
-		0xB2,					// animation control channel 2
-		pos,					// device id
-		v_,
-	};
+	if (!isEvent) {
+		return;
+	}
 
-	mMidiOut->sendMessage(&msg);
+	// ----------| invariant: a toggle, or peak, has just happened
 
+	if (d.lastEvent_us != 0) {
+		const float interval = float(now_us_ - d.lastEvent_us);
+
+		// values are written once per frame, so intervals jitter by
+		// up to a frame - anything within 15% counts as steady.
+		if (d.period_us > 0.f && std::fabs(interval - d.period_us) < 0.15f * d.period_us) {
+			d.stableEvents = uint8_t(std::min(d.stableEvents + 1, 255));
+			d.period_us += 0.25f * (interval - d.period_us);
+		} else {
+			d.stableEvents = 0;
+			d.period_us = interval;
+		}
+	}
+	d.lastEvent_us = now_us_;
 }
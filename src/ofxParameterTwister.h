@@ -2,9 +2,28 @@
 
 #include <memory>
 #include <array>
-#include "ofThreadChannel.h"
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <list>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "ofParameter.h"
 #include "RtMidi.h"
+#include "SpscRingBuffer.h"
+#include "MpscRingBuffer.h"
+#include "LatencyHistogram.h"
+#include "MfsMapping.h"
+#include "ValueTable.h"
+#include "ParameterIndex.h"
+#include "MidiRecording.h"
+#include "FrameProfiler.h"
+#include "StateMirror.h"
 
 
 class ofAbstractParameter;
@@ -15,8 +34,10 @@ class ofAbstractParameter;
   + we can set a parameter group
   + re can clear a parameter group
 
-  up to 16 parameters from the parameter group
-  bind/unbind automatically to twister:
+  up to 64 parameters from the parameter group
+  bind/unbind automatically to twister - 16 per bank,
+  the first 16 parameters go to bank 1, the next 16 to 
+  bank 2, and so on:
 
   float -> rotary controller
   bool  -> switch (button)
@@ -27,9 +48,20 @@ class ofAbstractParameter;
   parameter change outside of twister is sent to twister
   whilst parameters are bound to twister.
 
+  several twisters may be connected at the same time - each
+  one is a device with its own encoders, and its own group 
+  of parameters. all devices share one input queue.
+
 */
 #include <cstdint> ///< we include this to get access to standard sized types
 
+// set this to 1 (e.g. via ADDON_CFLAGS = -DOFX_PARAMETER_TWISTER_TRACE=1) 
+// to compile in midi message tracing. when 0, all tracing code is 
+// compiled out of the midi hot paths.
+#ifndef OFX_PARAMETER_TWISTER_TRACE
+#	define OFX_PARAMETER_TWISTER_TRACE 0
+#endif
+
 namespace pal {
 namespace Kontrol {
 
@@ -38,14 +70,14 @@ struct MidiCCMessage {
 	uint8_t controller = 0x00;
 	uint8_t value = 0x00;
 
-	int getCommand() {
+	int getCommand() const {
 		// command is in the most significant 
 		// 4 bits, so we shift 4 bits to the right.
 		// e.g. 0xB0
 		return command_channel >> 4;
 	};
 
-	int getChannel() {
+	int getChannel() const {
 		// channel is the least significant 4 bits,
 		// so we null out the high bits
 		return command_channel & 0x0F;
@@ -53,20 +85,350 @@ struct MidiCCMessage {
 
 };
 
+static_assert(sizeof(MidiCCMessage) == 3, "MidiCCMessage must map 1:1 onto a 3 byte midi CC message");
+
+/// current steady clock time in microseconds - this is the 
+/// time base for all timestamps taken by this addon.
+inline uint64_t steady_clock_us() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------
+/// \brief		incoming midi message, with timestamps
+/// \detail		this is what travels from the midi callback to update().
+/// MidiCCMessage itself stays a plain 3 byte message, as this is what
+/// gets written to the device.
+struct MidiInMessage {
+	MidiCCMessage msg;
+	uint8_t  device       = 0;		///< index of the device which sent the message
+	double   deviceTime   = 0.0;	///< sum of RtMidi delta times since the port was opened, in seconds
+	uint64_t received_us  = 0;		///< steady_clock_us() when the callback received the message
+};
 
+// ------------------------------------------------------
+/// \brief		in-memory trace of midi messages in and out
+/// \detail		recording a message is a timestamp and a push into a 
+/// lock-free ring - no formatting, no allocation, no locks - so it is 
+/// safe to trace from the midi driver thread. formatting happens in 
+/// dump(), which is meant to be called from the main thread.
+/// 
+/// messages are only recorded if tracing has been compiled in 
+/// (see OFX_PARAMETER_TWISTER_TRACE), and it is enabled at runtime.
+class MidiTrace {
+public:
+
+	static const bool COMPILED_IN = (OFX_PARAMETER_TWISTER_TRACE != 0);
+
+	struct Record {
+		uint64_t timestamp_us = 0; ///< steady clock time at which message was traced
+		uint8_t device = 0;        ///< index of the device the message came from, or went to
+		MidiCCMessage msg;
+	};
+
+private:
+
+	// one ring per direction, so that each ring is in chronological 
+	// order. with several devices, input is traced on several midi 
+	// driver threads, and output may be traced on several sender 
+	// threads, so each ring may have more than one producer.
+	MpscRingBuffer<Record> mIn{ 2 };
+	MpscRingBuffer<Record> mOut{ 2 };
+
+	std::atomic<bool> mEnabled{ false };
+
+	static Record makeRecord(const MidiCCMessage& msg_, uint8_t device_) {
+		Record r;
+		r.timestamp_us = steady_clock_us();
+		r.device = device_;
+		r.msg = msg_;
+		return r;
+	};
+
+public:
 
+	/// allocates trace storage - does nothing if tracing has not been compiled in.
+	/// \note not thread-safe, call before opening midi ports.
+	void setup(size_t capacity_) {
+		if (COMPILED_IN) {
+			mIn.reset(capacity_);
+			mOut.reset(capacity_);
+		}
+	};
+
+	void setEnabled(bool enabled_) {
+		mEnabled.store(enabled_, std::memory_order_relaxed);
+	};
+
+	bool isEnabled() const {
+		return COMPILED_IN && mEnabled.load(std::memory_order_relaxed);
+	};
+
+	// if the trace ring is full, records are dropped.
+	void traceIn(const MidiCCMessage& msg_, uint8_t device_) {
+		if (isEnabled())
+			mIn.tryPush(makeRecord(msg_, device_));
+	};
+
+	void traceOut(const MidiCCMessage& msg_, uint8_t device_) {
+		if (isEnabled())
+			mOut.tryPush(makeRecord(msg_, device_));
+	};
+
+	/// drains all trace records, and writes them in chronological
+	/// order to stream_. returns the number of records written.
+	size_t dump(std::ostream& stream_);
+};
+
+// ------------------------------------------------------
+/// \brief		fixed-capacity queue of outgoing midi messages
+/// \detail		messages are stored by value in a ring which is 
+/// preallocated with the queue, so pushing a message never allocates.
+/// 
+/// by default, all queued messages are sent to the midi out port in 
+/// one go when the queue is flushed, which typically happens once per 
+/// frame. 
+/// 
+/// optionally, messages may be sent by a background sender thread 
+/// instead, which paces writes so as not to overrun the device, and 
+/// so that a slow midi driver can never stall the thread which flushes.
+///
+/// where the midi api accepts several messages in one write (CoreMIDI
+/// packs them into a single packet), queued messages are sent in 
+/// batches, so that a full resync costs one driver transaction instead
+/// of one per message. other apis only take one message per write.
+class MidiOutQueue {
+public:
+
+	/// as many 3 byte messages as fit into the single, fixed-size 
+	/// (256 byte) packet CoreMIDI sends a batch in - enough for a full 
+	/// bank's worth of encoder state, and a bank change.
+	static const size_t MAX_BATCH_MESSAGES = 85;
+
+private:
+
+	struct Pending {
+		MidiCCMessage msg;
+		uint32_t queued_us = 0; ///< steady clock time (truncated) at which msg was queued
+	};
+
+	// producer: the thread calling push(), 
+	// consumer: the thread sending messages.
+	SpscRingBuffer<Pending> mRing{ 256 };
+
+	// the port may be swapped whilst the sender thread runs, for
+	// example when a device is lost, so every send holds this lock.
+	std::mutex mPortMutex;
+	RtMidiOut* mMidiOut = nullptr;
+	std::atomic<bool> mSendFailed{ false }; ///< set once the driver has refused a message
+	bool mBatchingEnabled = true;
+	bool mCanBatch = false; ///< true if batching is enabled, and the port accepts batches - guarded by mPortMutex
+
+	MidiTrace* mTrace = nullptr;
+	uint8_t mDevice = 0; ///< device id messages are traced with
+	
+	// scratch buffer handed to RtMidiOut::sendMessage for batches, 
+	// allocated once, and re-used for every write - single messages
+	// go through RtMidiOut::sendShortMessage. the batch keeps the messages
+	// written, for tracing, and latency. both are guarded by mPortMutex.
+	std::vector<unsigned char> mScratch = std::vector<unsigned char>(3 * MAX_BATCH_MESSAGES);
+	std::array<Pending, MAX_BATCH_MESSAGES> mBatch;
+
+	// sender thread
+	std::thread mSenderThread;
+	std::atomic<bool> mShouldRun{ false };
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	float mMessagesPerMs = 0.f;
+
+	std::atomic<uint32_t> mWorstLatency_us{ 0 };
+	std::atomic<uint64_t> mSentCount{ 0 };
+	
+	/// takes up to maxMessages_ messages from the ring, and writes them 
+	/// in as few writes as the port allows. returns the number of messages 
+	/// taken from the ring - if there is no port, these are discarded.
+	size_t sendBatch(size_t maxMessages_);
+	void senderThreadFunction();
+
+	static bool acceptsBatches(RtMidiOut* midiOut_) {
+		// CoreMIDI sends any number of complete messages in one packet. 
+		// ALSA and WinMM reject writes which hold more than one message.
+		return midiOut_ != nullptr && midiOut_->getCurrentApi() == RtMidi::MACOSX_CORE;
+	};
+
+public:
+
+	~MidiOutQueue() {
+		stopSenderThread();
+	};
+
+	/// re-allocates the ring, discarding any queued messages.
+	/// \note not thread-safe, call before starting the sender thread.
+	void setup(size_t capacity_) {
+		mRing.reset(capacity_);
+	};
+
+	/// sets the port messages get sent to - nullptr means messages 
+	/// are discarded. blocks whilst a message is being sent.
+	void setMidiOut(RtMidiOut* midiOut_) {
+		std::lock_guard<std::mutex> lock(mPortMutex);
+		mMidiOut = midiOut_;
+		mCanBatch = mBatchingEnabled && acceptsBatches(midiOut_);
+		mSendFailed = false;
+	};
+
+	/// like setMidiOut(), but never blocks: returns false, and leaves the
+	/// port untouched, if a message is being sent right now.
+	bool trySetMidiOut(RtMidiOut* midiOut_) {
+		std::unique_lock<std::mutex> lock(mPortMutex, std::try_to_lock);
+		if (!lock.owns_lock()) {
+			return false;
+		}
+		mMidiOut = midiOut_;
+		mCanBatch = mBatchingEnabled && acceptsBatches(midiOut_);
+		mSendFailed = false;
+		return true;
+	};
+
+	/// if false, every message gets written on its own.
+	/// takes effect with the next call to setMidiOut().
+	void setBatchingEnabled(bool enabled_) {
+		mBatchingEnabled = enabled_;
+	};
+
+	/// true if sending has failed since the port was last set - 
+	/// which usually means the device has gone.
+	bool hasSendFailed() const {
+		return mSendFailed.load(std::memory_order_relaxed);
+	};
+
+	void setTrace(MidiTrace* trace_, uint8_t device_ = 0) {
+		mTrace = trace_;
+		mDevice = device_;
+	};
+
+	/// starts sending messages from a background thread, at most 
+	/// messagesPerMs_ messages per millisecond. a value <= 0 means 
+	/// messages are sent as fast as the driver accepts them.
+	void startSenderThread(float messagesPerMs_);
+	void stopSenderThread();
+
+	bool isThreaded() const {
+		return mSenderThread.joinable();
+	};
+
+	/// number of messages queued, but not sent yet.
+	size_t size() const {
+		return mRing.size();
+	};
+
+	/// longest time, in microseconds, any message has spent between 
+	/// being queued and having been written to the midi out port.
+	uint32_t getWorstLatencyMicros() const {
+		return mWorstLatency_us.load(std::memory_order_relaxed);
+	};
+
+	void resetWorstLatency() {
+		mWorstLatency_us.store(0, std::memory_order_relaxed);
+	};
+
+	/// total number of messages written to the midi out port.
+	uint64_t getSentCount() const {
+		return mSentCount.load(std::memory_order_relaxed);
+	};
+
+	size_t getHighWaterMark() const {
+		return mRing.getHighWaterMark();
+	};
+
+	void resetHighWaterMark() {
+		mRing.resetHighWaterMark();
+	};
+
+	/// queues a message. returns false if the message could not be queued
+	/// because the ring is full. this can only happen if a sender thread 
+	/// is running - otherwise, a full ring gets flushed straight away.
+	bool push(const MidiCCMessage& msg_);
+	
+	/// sends all queued messages, or, if a sender thread is 
+	/// running, wakes the sender thread.
+	void flush();
+};
 
 class ofxParameterTwister
 {
+public:
 
-	struct Encoder {
+	// encoders are laid out bank-major, so that encoder i sits on
+	// bank i / ENCODERS_PER_BANK - this is also the controller id
+	// the device uses for it.
+	static const size_t NUM_BANKS = 4;
+	static const size_t ENCODERS_PER_BANK = 16;
+	static const size_t NUM_ENCODERS = NUM_BANKS * ENCODERS_PER_BANK;
+
+	/// how rotary parameters follow the values received from the device
+	enum class Smoothing {
+		NONE,				///< parameters are set to each value received (default)
+		ONE_POLE,			///< parameters glide towards new values, slowing down as they get close
+		CRITICALLY_DAMPED,	///< parameters ease in and out of new values, without overshooting
+	};
+
+	/// animations the twister runs by itself, see setAnimation()
+	enum class Animation {
+		NONE,	///< host values are shown (default)
+		STROBE,	///< lights toggle on and off
+		PULSE,	///< lights fade in and out
+	};
+
+	/// rates of device animations, in beats of the twister's tempo: 
+	/// one flash, or one pulse, every 8 beats - down to 16 per beat.
+	enum class AnimationRate : uint8_t {
+		BEATS_8 = 0,
+		BEATS_4,
+		BEATS_2,
+		BEATS_1,
+		BEATS_1_2,
+		BEATS_1_4,
+		BEATS_1_8,
+		BEATS_1_16,
+	};
+
+private:
+
+	struct Binding;
 
-		RtMidiOut*	mMidiOut = nullptr;
+	// the state which the input, and the flush pass look at for every 
+	// message, and every frame - one bit per encoder, so that these 
+	// passes touch a single cache line per device, and only ever touch
+	// encoders which have something to do.
+	struct EncoderMasks {
+		uint64_t rotary = 0;	///< encoders in State::ROTARY
+		uint64_t toggle = 0;	///< encoders in State::SWITCH
+		uint64_t dirty = 0;		///< encoders with slots to send
+		uint64_t changed = 0;	///< encoders with a collapsed value pending, see InputDelivery::LATEST_PER_FRAME
+		uint64_t smoothing = 0;	///< encoders whose parameter is still converging
+		uint64_t mirrored = 0;	///< encoders with a value to mirror, see startMirrorSender()
+	};
+
+	struct Encoder {
 
 		// position on the controller left to right,
-		// top to bottom
+		// top to bottom, bank after bank - 0..63
 		uint8_t pos = 0;
 
+		// masks of the device this encoder belongs to - set once, 
+		// when the device is created. encoders keep their bits in 
+		// these masks up to date.
+		EncoderMasks* mMasks = nullptr;
+
+		// profiler of the twister this encoder belongs to - set once,
+		// like mMasks.
+		FrameProfiler* mProfiler = nullptr;
+
+		uint64_t bit() const {
+			return 1ULL << pos;
+		};
+
 		// knob may be either 
 		// disabled, or a rotary controller, or a switch.
 		enum class State {
@@ -79,10 +441,115 @@ class ofxParameterTwister
 		// may be 0..127
 		uint8_t value = 0;
 
-		// event listener for parameter change
+		// event listener for parameter change - with SyncMode::POLL, 
+		// there is none, and update() compares against mSyncedValue.
 		ofEventListener mELParamChange;
+		uint8_t mSyncedValue = 0; ///< parameter value last synced, SyncMode::POLL only
+		bool mIsPolled = false; ///< bound without a listener, see bind()
+
+		// the binding this encoder currently follows - owned by the 
+		// page cache, nullptr if the encoder is not bound.
+		const Binding* mBinding = nullptr;
+
+		/// binds encoder to a (prepared) binding, or unbinds it if b_ is
+		/// nullptr. only changes in device state will get sent. with 
+		/// listen_, the encoder follows parameter changes as they happen, 
+		/// otherwise only when sync() is called.
+		void bind(const Binding* b_, bool listen_);
 
-		std::function<void(uint8_t v_)> updateParameter;
+		/// sends the bound parameter's value, if it has changed since 
+		/// it was last synced - for SyncMode::POLL.
+		void sync();
+
+		/// with SyncMode::POLL, syncs a change we have just written to 
+		/// the parameter ourselves, which no listener has seen - so that
+		/// sync() never sends back what the device shows already.
+		void syncWritten();
+		
+		bool isBound() const;
+
+		/// applies a midi value to the bound parameter
+		void updateParameter(uint8_t v_);
+
+		// echo suppression: the device shows values it sends without
+		// being told, so whilst we apply them, the parameter changes 
+		// we cause must not be sent back. only changes which start on 
+		// the host get sent.
+		bool mIsApplyingInput = false;
+
+		/// records an absolute value the device has sent - the device
+		/// shows this value already. 
+		void receive(uint8_t v_);
+
+		// relative mode: the device sends signed deltas, which we 
+		// accumulate into a double precision position, so that 
+		// steps much finer than 1/128th of the range add up.
+		double mPosition = 0.0;			///< normalised 0..1
+		float mLastWritten = -1.f;		///< normalised value last written to the parameter, -1 if none
+		uint64_t mLastTick_us = 0;		///< receive time of the last delta, for acceleration
+
+		/// turns a relative midi value (64 +/- delta) into a number of
+		/// ticks, which grows with the speed at which the knob turns.
+		float accelerate(uint8_t v_, uint64_t received_us_, float maxAcceleration_);
+
+		/// moves the bound parameter by ticks_, where 128 ticks span 
+		/// range_ times the parameter's full range.
+		void nudgeParameter(float ticks_, float range_);
+
+		/// advances the relative position by ticks_, and returns it - 
+		/// without applying it to the parameter.
+		float advanceRelative(float ticks_, float range_);
+
+		/// sets the parameter, and remembers what it now holds.
+		void writeNormalized(float n_);
+
+		/// true if the bound parameter has a normalised range
+		bool canSmooth() const;
+
+		// smoothing: whilst converging, the parameter moves 
+		// towards the target with every step.
+		bool mIsSmoothing = false;
+		float mSmoothTarget = 0.f;		///< normalised 0..1
+		float mSmoothValue = 0.f;		///< normalised 0..1
+		float mSmoothVelocity = 0.f;	///< per second, critically damped smoothing only
+		uint64_t mSmoothLast_us = 0;	///< time of the last step
+
+		bool mSmoothTargetShown = false;	///< device shows the target already, so steps don't get sent
+
+		void startSmoothing(float target_, uint64_t now_us_, bool targetShown_);
+
+		/// moves the parameter towards its target - returns false 
+		/// once the parameter has settled.
+		bool stepSmoothing(Smoothing mode_, float time_, uint64_t now_us_);
+
+		// outgoing device state is tracked per "slot", i.e. per 
+		// property of the encoder which the device keeps separately.
+		// slots are sent in this order when the encoder is flushed.
+		enum OutSlot : uint8_t {
+			OUT_ANIMATION = 0,		// channel 2
+			OUT_SWITCH,				// channel 1
+			OUT_ROTARY,				// channel 0
+			OUT_BRIGHTNESS_ROTARY,	// channel 2
+			OUT_BRIGHTNESS_RGB,		// channel 2
+			OUT_DEVICE_ANIMATION,	// channel 2, last - so that brightness can't cancel it
+			OUT_COUNT,
+		};
+
+		// shadow of the device state for this encoder.
+		// send* methods only update the target state, and mark
+		// slots dirty if their target differs from what the device
+		// is showing - flush() then sends only the last value per 
+		// dirty slot.
+		struct Shadow {
+			static const uint8_t UNKNOWN = 0xFF; ///< never a valid 7 bit midi value
+			std::array<uint8_t, OUT_COUNT> target{ { 0, 0, 0, 0, 0, 0 } };
+			std::array<uint8_t, OUT_COUNT> sent{ { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN } };
+			uint8_t dirty = 0; ///< bitfield, one bit per OutSlot
+		} mShadow;
+
+		void stage(OutSlot slot_, uint8_t v_);
+		void invalidateShadow(); ///< forces all slots to be resent with next flush
+		void flush(MidiOutQueue& queue_); ///< slots which could not be queued stay dirty
 
 		void setState(State s_, bool force_ = false);
 		void setValue(uint8_t v_);
@@ -93,29 +560,711 @@ class ofxParameterTwister
 		void setEncoderAnimation(uint8_t v_);
 		void setBrightnessRotary(float b_); /// brightness is normalised over 31 steps 0..30
 		void setBrightnessRGB(float b_);
+
+		// device animation: whilst set, the device animates the LEDs 
+		// of this encoder by itself - rotaries their indicator ring, 
+		// switches their RGB LED - and host values are not sent.
+		Animation mAnimation = Animation::NONE;
+		AnimationRate mAnimationRate = AnimationRate::BEATS_1;
+		bool mIsAnimationDetected = false; ///< started by detection, rather than by setAnimation()
+
+		/// hands the LEDs to the device, or - with Animation::NONE - 
+		/// takes them back, and shows the parameter's value again.
+		void setDeviceAnimation(Animation a_, AnimationRate rate_, bool detected_);
+
+		// detection of periodic changes made by the host: switches 
+		// which toggle, or rotaries which swing back and forth, at a
+		// steady rate.
+		bool mDetectAnimation = false;
+		struct PeriodDetector {
+			uint64_t lastEvent_us = 0;	///< last toggle (switches), or last peak (rotaries)
+			float period_us = 0.f;		///< running estimate of the time between events
+			uint8_t stableEvents = 0;	///< events in a row which matched the estimate
+			int8_t direction = 0;		///< rotaries: direction of the last change
+			uint8_t lastValue = Shadow::UNKNOWN;
+		} mDetector;
+
+		void detect(uint8_t v_, uint64_t now_us_);
+	};
+
+	// what an encoder can do with the parameter it is bound to. there 
+	// is one static table per parameter type, so bindings hold no 
+	// closures, and applying a value is a plain function call.
+	struct BindingOps {
+		void(*updateParameter)(const Binding& b_, uint8_t v_);		///< midi -> parameter
+		uint8_t(*readValue)(const Binding& b_);						///< parameter -> midi
+		float(*readNormalized)(const Binding& b_);					///< parameter -> 0..1, nullptr unless rotary
+		void(*setNormalized)(const Binding& b_, float n_);			///< 0..1 -> parameter, nullptr unless rotary
+		ofEventListener(*listen)(const Binding& b_, Encoder& e_);	///< track parameter changes
+	};
+
+	// a binding is everything an encoder needs to follow a parameter,
+	// prepared once per parameter group, and kept in the page cache, 
+	// so that switching back to a group needs no preparation.
+	struct Binding {
+		Encoder::State state = Encoder::State::DISABLED;
+		std::shared_ptr<ofAbstractParameter> param;
+		const BindingOps* ops = nullptr;
+		uint8_t component = 0; ///< which component of the parameter this encoder follows, for parameters spread over several encoders
+	};
+
+	struct PageCacheEntry;
+
+	// an opened pair of midi ports. connections are opened, and 
+	// closed, on the connection thread, as drivers may take
+	// their time doing either.
+	struct Connection {
+		std::string name;				///< name of the input port
+		RtMidiIn*	midiIn = nullptr;
+		RtMidiOut*	midiOut = nullptr;
+
+		~Connection(); ///< closes midi ports
+	};
+
+	// everything we keep per twister. devices are heap-allocated, 
+	// and never move, as encoders are referenced by parameter 
+	// listeners, and devices by midi callbacks. a device outlives
+	// its connection, so that its state can be replayed once the 
+	// twister gets re-connected.
+	struct Device {
+		ofxParameterTwister* owner = nullptr;	///< so the midi callback can reach the shared queue
+		uint8_t id = 0;							///< index into mDevices, tagged onto every message received
+		std::string name;						///< name of the port this device was last connected to
+
+		std::unique_ptr<Connection> connection;	///< nullptr whilst the device is not connected
+		bool isLost = false;					///< set when the connection has gone, until it has been retired
+		MidiOutQueue outQueue;
+
+		double deviceTime = 0.0; ///< accumulated midi delta time, only touched by the midi callback, or by polling
+
+		// with Settings::pollInput, arrival times are estimated from 
+		// deviceTime: offset from device timeline to steady clock.
+		bool hasPollOffset = false;
+		int64_t pollOffset_us = 0;
+		ValueTable values;		 ///< written by the midi callback, if Settings::publishValues
+
+		EncoderMasks masks;
+		std::array<Encoder, NUM_ENCODERS> encoders;
+		const PageCacheEntry* page = nullptr; ///< page the encoders are bound to, nullptr if none
+		std::array<size_t, NUM_BANKS> bankPages{ { 0, 1, 2, 3 } }; ///< page of the bound group each bank shows
+
+		// bank currently shown on the device - only encoders on this
+		// bank get their state sent, the others keep their changes 
+		// until their bank becomes visible.
+		size_t activeBank = 0;
+		bool bankChangePending = false; ///< set if the device needs to be told to switch banks
+
+		std::array<uint8_t, NUM_ENCODERS> latestValues;	///< scratch table for InputDelivery::LATEST_PER_FRAME
+		std::array<uint64_t, NUM_ENCODERS> latestTimes;	///< receive time of oldest message collapsed into latestValues
+		std::array<float, NUM_ENCODERS> latestTicks{};	///< relative ticks collapsed, for EncoderMode::RELATIVE
+		std::array<MirrorValue, NUM_ENCODERS> mirrorValues;	///< latest value applied per rotary, see startMirrorSender()
+
+		Device();
+		~Device(); ///< stops sending, and closes midi ports
 	};
 
 
 public:
-	
+
+	/// how incoming midi values get applied to parameters in update()
+	enum class InputDelivery {
+		EACH_MESSAGE,		///< every message received sets its parameter (default)
+		LATEST_PER_FRAME,	///< rotary values are collapsed, so that each parameter is set at most once per update()
+	};
+
+	/// how changes to bound parameters reach the twister
+	enum class SyncMode {
+		LISTENERS,	///< each bound parameter has a listener, which follows every set() (default)
+		POLL,		///< no listeners: update() compares each bound parameter against the value last synced
+	};
+
+	/// how rotary messages from the device are read. this must match 
+	/// the encoder type the twister has been programmed with, using 
+	/// the Midi Fighter Utility.
+	enum class EncoderMode {
+		ABSOLUTE,	///< values 0..127 map onto the parameter's range (device default)
+		RELATIVE,	///< values are deltas around 64, e.g. 63: -1, 65: +1 ("ENC 3FH/41H")
+	};
+
+	/// what the four banks of a twister are used for
+	enum class BankLayout {
+		PAGES,		///< each bank shows the next 16 parameters of the group (default)
+		FINE_TUNE,	///< every bank shows the first 16 parameters, each bank with finer steps than the one before
+	};
+
+	/// controller integration health, see getStats()
+	struct Stats {
+		// latency from the midi callback receiving a message, to the 
+		// message's value having been applied to its parameter.
+		uint32_t latencyP50_us = 0;
+		uint32_t latencyP99_us = 0;
+		uint32_t latencyMax_us = 0;
+
+		// message rates, averaged over the last full second
+		float messagesInPerSecond  = 0.f;
+		float messagesOutPerSecond = 0.f;
+
+		// totals since the last call to resetStats()
+		uint64_t messagesIn  = 0;	///< messages taken from the input queue
+		uint64_t messagesOut = 0;	///< messages written to the midi out port
+		
+		// largest number of messages waiting in each queue
+		size_t inputQueueHighWater  = 0;
+		size_t outputQueueHighWater = 0;
+
+		uint64_t inputOverflowCount = 0; ///< see getInputOverflowCount()
+	};
+
+	struct Settings {
+		/// maximum number of incoming midi messages which may be 
+		/// buffered between two calls to update(). messages arriving
+		/// whilst the queue is full are dropped, and counted.
+		size_t inputQueueCapacity = 1024;
+		
+		/// number of messages per direction the midi trace can hold
+		/// before it needs to be dumped. only allocated when tracing
+		/// is compiled in, see OFX_PARAMETER_TWISTER_TRACE.
+		size_t traceCapacity = 4096;
+
+		/// maximum number of outgoing midi messages queued at any time.
+		size_t outputQueueCapacity = 256;
+
+		/// if true, midi messages are sent from a background thread, 
+		/// so that a slow driver never blocks update(). 
+		bool useSenderThread = false;
+
+		/// rate limit for the sender thread: the maximum number of 
+		/// messages written per millisecond, <= 0 means no limit.
+		/// one message per millisecond is roughly what a classic 
+		/// 31250 baud midi link transports.
+		float senderMessagesPerMs = 1.f;
+
+		/// if true, messages queued in the same frame are written to 
+		/// the device in as few driver calls as the midi api allows.
+		/// with the sender thread, batches never exceed the rate limit.
+		bool batchOutput = true;
+
+		/// every midi port whose name contains this string is opened
+		/// as a device. input and output ports are paired up by name,
+		/// in the order the midi driver lists them.
+		std::string portName = "Midi Fighter Twister";
+
+		/// if true, setup() returns straight away, and twisters get 
+		/// opened on a background thread - see deviceConnected.
+		/// if false, setup() waits until all twisters found are open.
+		bool openDevicesInBackground = true;
+
+		/// how often the background thread checks for twisters which 
+		/// have been plugged in, or unplugged. <= 0 means ports are 
+		/// only scanned once, on setup().
+		float watchdogIntervalSeconds = 1.f;
+
+		/// if true, the midi callback also writes every value it receives
+		/// straight into the device's value table, so that threads other 
+		/// than the main thread can read values as soon as they arrive - 
+		/// see getValueTable(). parameters still get set in update().
+		bool publishValues = false;
+
+		/// if true, no midi callback gets installed: messages wait in 
+		/// RtMidi's own input queue of each device, and update() drains 
+		/// these queues directly - one copy, and one hand-over between 
+		/// threads, less per message. inputQueueCapacity then sizes each 
+		/// device's RtMidi queue. suits apps which call update() once 
+		/// per frame from one thread. publishValues, and recording, 
+		/// see messages only once update() has polled them.
+		bool pollInput = false;
+	};
 	
 	~ofxParameterTwister();
 
+	/// notified from update() with the device index, whenever a 
+	/// twister has been (re-)connected and its state is about to be sent.
+	ofEvent<size_t> deviceConnected;
+
+	/// notified from update() with the device index, whenever a 
+	/// twister has gone. its parameters stay bound, and its state 
+	/// gets replayed once it is connected again.
+	ofEvent<size_t> deviceDisconnected;
+
 	void setup();
+	void setup(const Settings& settings_);
+
+	void update(); // this is where we apply values, and send queued midi messages.
+
+	/// binds group_ to the encoders of device_. the same group may 
+	/// be bound to more than one device. if there is no device_ yet,
+	/// devices get added, and the next twisters found connect to them.
+	/// 
+	/// groups nested in group_ get flattened, and their parameters 
+	/// split into pages of 16 encoders: page n holds encoders 
+	/// [16n, 16n + 16). banks 1..4 show pages 0..3, until pages get 
+	/// flipped, see setPage().
+	void setParams(const ofParameterGroup& group_, size_t device_ = 0);
+
+	/// shows page_ on the current bank of device_ - only this bank's
+	/// encoders get re-bound. pages also flip with the twister's side
+	/// buttons, if these are set to send CC: buttons on the left flip to 
+	/// the previous page, buttons on the right to the next page.
+	void setPage(size_t page_, size_t device_ = 0);
+
+	/// page shown on the current bank of device_
+	size_t getPage(size_t device_ = 0) const;
+
+	/// number of pages the group bound to device_ fills
+	size_t getNumPages(size_t device_ = 0) const;
+
+	/// captures the values of all parameters bound to device_ - on all
+	/// pages - as one flat block of values. returns the snapshot's id.
+	size_t storeSnapshot(size_t device_ = 0);
+
+	/// sets all parameters captured in snapshot_ back to their stored 
+	/// values, in one go - the twister follows with the next update(). 
+	/// with morphSeconds_ > 0, rotary parameters move from where they
+	/// are to their stored values over this time, one step with each 
+	/// update(), and switches change once the morph completes. returns
+	/// false if snapshot_ does not exist, or if its group has changed 
+	/// since it was stored.
+	bool recallSnapshot(size_t snapshot_, float morphSeconds_ = 0.f);
+
+	/// frees snapshot_ - snapshot ids are never re-used.
+	void deleteSnapshot(size_t snapshot_);
+	void clearSnapshots();
+
+	bool isMorphing() const;
+
+	/// records all midi input, from all devices, to path_ (relative to 
+	/// the data folder) - as a compact binary log, written on a 
+	/// background thread. returns false if path_ can't be written. 
+	bool startRecording(const std::string& path_);
+	void stopRecording();
+	bool isRecording() const;
+
+	/// plays a recording back: its messages go into the input queue at
+	/// the times they were recorded, just as if the twisters had sent 
+	/// them - so that update() applies them exactly as it did when they
+	/// were recorded. the file is streamed, not loaded. messages for 
+	/// devices which don't exist are skipped. with loop_, playback 
+	/// restarts at the end of the recording. 
+	bool startPlayback(const std::string& path_, bool loop_ = false);
+	void stopPlayback();
+	bool isPlaying() const;
+
+	/// mirrors controller state to other nodes - say, render machines
+	/// which bind the same parameter groups, but have no twister. once 
+	/// per update(), the values applied from midi since the last frame
+	/// go out as one udp datagram, to host_ - which may be a broadcast 
+	/// address. every keyframeInterval_ seconds, the datagram holds all
+	/// bound encoders instead, for followers which join late.
+	bool startMirrorSender(const std::string& host_, int port_, float keyframeInterval_ = 1.f);
+
+	/// applies state mirrored by a sender listening on port_ as if it
+	/// came from local twisters: values arrive in update(), go through
+	/// the same bindings, and smoothing, and devices flip to the pages
+	/// the sender's devices show.
+	bool startMirrorFollower(int port_);
+
+	/// stops sending, or following, mirrored state
+	void stopMirror();
+
+	/// number of twisters seen so far, connected or not. there is 
+	/// always at least one device, so that parameters can be bound 
+	/// even before a twister has been plugged in. devices are never 
+	/// removed, and a twister which gets re-connected re-uses its
+	/// device.
+	size_t getNumDevices() const;
+
+	bool isConnected(size_t device_) const;
+
+	/// name of the midi port device_ was last opened on, or an 
+	/// empty string if no twister has been found for this device.
+	const std::string& getDeviceName(size_t device_) const;
+
+	/// latest values received from device_, for consumers on other
+	/// threads (audio, simulation) which can't wait for update(). fetch 
+	/// the table on the main thread, then read it from any thread, at 
+	/// any rate. values are as sent by the twister, i.e. the table 
+	/// follows encoders, not parameters, and holds absolute values only.
+	/// requires Settings::publishValues. the table stays valid until 
+	/// the next call to setup().
+	const ValueTable& getValueTable(size_t device_ = 0);
+
+	/// switches device_ to show bank_ (0..3). banks also change
+	/// when switched on the device itself.
+	void setBank(size_t bank_, size_t device_ = 0);
+	size_t getBank(size_t device_ = 0) const;
+
+	/// number of incoming midi messages dropped so far because 
+	/// the input queue was full.
+	uint64_t getInputOverflowCount() const;
+
+	/// choose whether update() applies every midi message received, or
+	/// only the latest value per encoder. collapsing values means that 
+	/// parameter listeners fire at most once per frame, however fast 
+	/// knobs are turned. switch messages are always applied one by one.
+	void setInputDelivery(InputDelivery mode_);
+
+	/// choose how parameter changes get to the twister. with 
+	/// SyncMode::POLL, parameters bound to encoders get no listeners: 
+	/// once per update(), each one is compared against the value last 
+	/// synced, and what differs gets sent. this costs one comparison 
+	/// per encoder per frame, however often parameters are set - and 
+	/// changes only reach the device with the next update().
+	void setSyncMode(SyncMode mode_);
+	SyncMode getSyncMode() const;
+
+	/// in relative mode, turning a knob quickly moves its parameter
+	/// faster, by up to maxAcceleration_ times.
+	void setEncoderMode(EncoderMode mode_, float maxAcceleration_ = 4.f);
+
+	/// with BankLayout::FINE_TUNE, a full turn of 128 ticks moves the 
+	/// parameter by its full range on bank 1, by 1/2 on bank 2, by 1/4 
+	/// on bank 3, and by 1/16 on bank 4. fine-tuning needs relative 
+	/// mode, see setEncoderMode().
+	void setBankLayout(BankLayout layout_);
+
+	/// smooths out the steps between midi values: rotary parameters 
+	/// glide towards the values received, with time constant time_, in 
+	/// seconds. parameters are moved in update(), which spends at most 
+	/// budget_us_ microseconds on this - parameters which have settled 
+	/// cost nothing.
+	void setSmoothing(Smoothing mode_, float time_ = 0.05f, uint32_t budget_us_ = 1000);
+
+	/// lets the twister animate the encoder which shows param_, rather
+	/// than streaming its values: rotaries strobe, or pulse, their 
+	/// indicator ring, switches their RGB LED. whilst animated, changes
+	/// to param_ are not sent - Animation::NONE shows them again. the 
+	/// animation stays with param_ across pages, groups, and devices.
+	void setAnimation(const ofAbstractParameter& param_, Animation animation_, AnimationRate rate_ = AnimationRate::BEATS_1);
+
+	/// with detection enabled, parameters which the host changes at a
+	/// steady rate - say, driven by an lfo - are animated by the 
+	/// twister for as long as the pattern holds: switches toggling 
+	/// strobe, rotaries swinging back and forth pulse. bpm_ is the 
+	/// tempo the twister animates at, to pick the closest rate.
+	void setAnimationDetection(bool enabled_, float bpm_ = 120.f);
+
+	/// moves smoothed parameters on a background thread, at a fixed 
+	/// rate, instead of in update() - for parameters which are consumed
+	/// off the main thread. whilst the worker runs, it takes turns with
+	/// update(), setParams(), and the setters, so parameter listeners 
+	/// may fire on the worker thread.
+	void startSmoothingWorker(float rateHz_ = 240.f);
+	void stopSmoothingWorker();
+
+	/// number of outgoing midi messages queued, but not sent yet.
+	size_t getOutputQueueDepth() const;
+
+	/// longest time, in microseconds, an outgoing message spent 
+	/// waiting to be sent, including the time the driver took to send it.
+	uint32_t getWorstSendLatencyMicros() const;
+
+	/// returns latency percentiles, message rates and queue high 
+	/// water marks. call from the same thread which calls update().
+	Stats getStats() const;
+	void resetStats();
 
-	void update(); // this is where we apply values.
-	void setParams(const ofParameterGroup& group_);
+	/// checks that mapping_ sets up encoders the way we expect them to
+	/// send messages - for the current encoder mode, see setEncoderMode().
+	/// logs every problem, and returns true if there are none.
+	bool checkMapping(const MfsMapping& mapping_) const;
+
+	/// enables recording of midi messages to the in-memory trace.
+	/// has no effect unless tracing is compiled in.
+	void setTraceEnabled(bool enabled_);
+
+	/// writes, and clears, all midi messages traced so far.
+	/// call this from the main thread, never from a midi callback.
+	size_t dumpTrace(std::ostream& stream_);
+
+	/// calls, and time spent, in the midi callback, the input drain,
+	/// setParams(), encoder sends and parameter listeners - plus midi
+	/// bytes sent - over the last full frame. all zero unless profiling
+	/// is compiled in, see OFX_PARAMETER_TWISTER_PROFILE. call from the
+	/// same thread which calls update().
+	const FrameReport& getFrameReport() const;
 
 private:
 
-	RtMidiIn*	mMidiIn = nullptr;
-	RtMidiOut*	mMidiOut = nullptr;
+	/// \brief		callback for midi input, called on the midi driver thread
+	/// \note		RtMidi only passes 3 byte channel messages to this callback,
+	/// without a message vector - which is all the twister sends.
+	static void _midi_callback(double deltatime, unsigned char status, unsigned char data1, unsigned char data2, void *device);
+
+	/// turns a message received from d_ into m_, and does what needs 
+	/// doing as soon as a message arrives: tracing, publishing, recording.
+	/// may run on the midi driver thread.
+	static void receiveMessage(Device& d_, double deltatime_, uint8_t status_, uint8_t controller_, uint8_t value_, MidiInMessage& m_);
+
+	/// with Settings::pollInput: drains RtMidi's input queues of all
+	/// connected devices, and processes their messages.
+	void pollDevices();
+	std::vector<unsigned char> mPollMessage; ///< re-used for every message polled
+
+	/// applies m_ - or, for InputDelivery::LATEST_PER_FRAME, collapses
+	/// it into the latest value of its encoder.
+	void processMessage(const MidiInMessage& m_);
+
+	/// for InputDelivery::LATEST_PER_FRAME: applies all values collapsed 
+	/// since the last call.
+	void applyCollapsed();
+
+	/// a binder prepares bindings for a parameter of a specific type. 
+	/// parameters with several components (colours, vectors) take one
+	/// encoder per component, starting at b_. returns the number of 
+	/// bindings prepared, or 0 if the parameter needs more than 
+	/// available_ encoders.
+	typedef size_t(*Binder)(Binding* b_, size_t available_, const std::shared_ptr<ofAbstractParameter>& param_);
+
+	/// maps parameter types, as reported by ofAbstractParameter::type(),
+	/// to the binder which knows how to bind parameters of this type.
+	class BinderRegistry {
+		std::unordered_map<std::string, Binder> mBinders;
+	public:
+		template<typename T>
+		void add(Binder binder_) {
+			mBinders[typeid(ofParameter<T>).name()] = binder_;
+		};
+		
+		/// returns nullptr if there is no binder for this parameter type.
+		Binder find(const ofAbstractParameter& param_) const {
+			auto it = mBinders.find(param_.type());
+			return (it != mBinders.end()) ? it->second : nullptr;
+		};
+	};
+
+	static const BinderRegistry& getBinderRegistry();
+
+	/// binds a parameter whose components map to rotary encoders
+	/// (float, int, colours, vectors). defined, and instantiated, in 
+	/// the implementation only.
+	template<typename T>
+	struct RotaryBinder;
+
+	/// binds bool parameters to switches, which toggle.
+	struct SwitchBinder;
+
+	/// binds ofParameter<void> to switches, which trigger whilst pressed.
+	struct TriggerBinder;
+
+	// bindings prepared for each group we have been asked to bind, 
+	// so that switching back to a group needs no type lookups, and 
+	// builds no closures. bindings for all parameters in the group,
+	// nested groups flattened, are held in one flat table, so that 
+	// finding the bindings for a page takes no search.
+	struct PageCacheEntry {
+		ParameterIndex index; ///< shares the group, so it can't be a dangling key
+		std::vector<Binding> bindings; ///< one per encoder, whole pages, and at least one page per bank
+		std::vector<Binding> retiredBindings; ///< replaced by the last re-build, kept until setParams() has re-bound the encoders which pointed to them
+		uint64_t generation = 0; ///< changes whenever bindings get re-built
+		mutable size_t numSnapshots = 0; ///< pages with snapshots are never evicted
+
+		size_t getNumPages() const {
+			return bindings.size() / ENCODERS_PER_BANK;
+		};
+
+		/// first of the ENCODERS_PER_BANK bindings for page_
+		const Binding* getPage(size_t page_) const {
+			return &bindings[std::min(page_, getNumPages() - 1) * ENCODERS_PER_BANK];
+		};
+	};
+
+	static const size_t PAGE_CACHE_SIZE = 16; ///< least recently used pages get evicted beyond this
+
+	// most recently used first. a list, so that bindings don't move 
+	// whilst encoders point to them.
+	std::list<PageCacheEntry> mPageCache;
+
+	PageCacheEntry& preparePage(const ofParameterGroup& group_);
+
+	uint64_t mNextPageGeneration = 1;
+
+	// all snapshots' values live back to back in one arena, one value
+	// per binding of the page they were taken from: rotary values 
+	// normalised 0..1, switches 0 or 1.
+	struct Snapshot {
+		const PageCacheEntry* page = nullptr;	///< nullptr once deleted
+		uint64_t generation = 0;				///< of the page's bindings, when captured
+		size_t offset = 0;						///< of the snapshot's first value in mSnapshotValues
+		size_t count = 0;						///< number of values
+	};
+
+	std::vector<Snapshot> mSnapshots;
+	std::vector<float> mSnapshotValues;
+
+	// the morph in progress, if any - there is only ever one.
+	struct Morph {
+		bool isActive = false;
+		size_t snapshot = 0;
+		std::vector<float> from;	///< values when the morph started, re-used from morph to morph
+		uint64_t start_us = 0;
+		uint64_t duration_us = 0;
+	} mMorph;
+
+	/// moves parameters towards the morph's snapshot
+	void stepMorph(uint64_t now_us_);
+
+	static float readSnapshotValue(const Binding& b_);
+	static void applySnapshotValue(const Binding& b_, float v_);
+
+	/// returns the encoder message m_ is meant for, or nullptr if 
+	/// the message does not apply to any parameter bound to an encoder.
+	Encoder* encoderForMessage(Device& d_, const MidiCCMessage& m_);
+
+	// connection thread: scans for twisters, opens the ports of 
+	// new ones, and closes the ports of those which have gone. 
+	// connections travel between update() and this thread through 
+	// lists guarded by mConnectMutex - the lock is only ever held 
+	// to swap list contents, never whilst talking to a driver.
+	std::thread mConnectThread;
+	std::mutex mConnectMutex;
+	std::condition_variable mConnectWake;
+	bool mShouldConnect = false;		///< guarded by mConnectMutex
+
+	std::vector<std::unique_ptr<Connection>> mOpened;	///< opened on the connection thread, not adopted yet
+	std::vector<std::unique_ptr<Connection>> mRetired;	///< given up by update(), to be closed on the connection thread
+	std::vector<std::string> mNamesInUse;				///< names of connections devices hold, kept by update()
+	std::vector<std::string> mLostNames;				///< names the connection thread could not find anymore
+
+	/// scans straight away if scanFirst_, otherwise waits until the
+	/// first watchdog interval has passed.
+	void connectThreadFunction(bool scanFirst_);
+	
+	/// enumerates ports once, opens ports which belong to twisters 
+	/// we don't know yet, and reports twisters which have gone.
+	/// runs on the connection thread, or in setup().
+	void scanPorts(RtMidiIn& probeIn_, RtMidiOut& probeOut_);
+	
+	/// adopts newly opened connections, and retires lost ones - 
+	/// never blocks: if the connection thread holds the lock, 
+	/// we try again next frame.
+	void updateConnections();
+	void stopConnectThread();
+
+	/// adds a device which is not connected yet.
+	Device& addDevice();
+
+	Settings mSettings;
+
+	// transport between the midi driver threads of all devices 
+	// (producers) and update() (consumer).
+	MpscRingBuffer<MidiInMessage> mMidiInQueue;
+
+	MidiTrace mTrace;
+
+	// written to by midi callbacks, and encoders - so declared before the devices
+	FrameProfiler mProfiler;
+
+	// written to by midi callbacks, too - so declared before the devices
+	MidiRecorder mRecorder;
 
-	ofThreadChannel<MidiCCMessage> mChannelMidiIn;
+	MidiPlayer mPlayer;
+	uint64_t mPlaybackStart_us = 0;
+	MidiRecordingEvent mPendingPlayback;	///< due, but did not fit the input queue
+	bool mHasPendingPlayback = false;
+
+	/// moves recorded messages which are due into the input queue
+	void stepPlayback(uint64_t now_us_);
+
+	// state mirror - at most one of sender, and receiver, is set
+	std::unique_ptr<MirrorSender> mMirrorSender;
+	std::unique_ptr<MirrorReceiver> mMirrorReceiver;
+	uint64_t mMirrorKeyframeInterval_us = 1000000;
+	uint64_t mNextMirrorKeyframe_us = 0;
+	std::vector<MirrorValue> mMirrorSwitches;	///< switch values applied this frame, in order
+	MirrorFrame mMirrorFrame;					///< scratch, re-used for every datagram received
+
+	/// remembers a value applied to e_, for the next datagram
+	void mirrorValue(Device& d_, Encoder& e_, uint16_t v_, bool isFine_);
+	void sendMirror(uint64_t now_us_);
+	void receiveMirror();
 
 	ofParameterGroup mParams;
 
-	std::array<ofxParameterTwister::Encoder, 16> mEncoders;
+	// declared after the input queue, so that midi callbacks are 
+	// gone before the queue they write to.
+	std::vector<std::unique_ptr<Device>> mDevices;
+	
+	/// handles bank changes, returns true if m_ was a system message.
+	bool handleSystemMessage(Device& d_, const MidiCCMessage& m_);
+
+	InputDelivery mInputDelivery = InputDelivery::EACH_MESSAGE;
+	EncoderMode mEncoderMode = EncoderMode::ABSOLUTE;
+	SyncMode mSyncMode = SyncMode::LISTENERS;
+
+	// animations flagged with setAnimation()
+	struct AnimationFlag {
+		std::shared_ptr<ofAbstractParameter> param;
+		Animation animation = Animation::NONE;
+		AnimationRate rate = AnimationRate::BEATS_1;
+	};
+	std::vector<AnimationFlag> mAnimationFlags;
+
+	bool mDetectAnimations = false;
+	float mAnimationBpm = 120.f;
+
+	/// starts the animation flagged for the parameter encoder e_ shows, if any
+	void applyAnimationFlag(Encoder& e_);
+
+	/// starts, and stops, animations as detection finds patterns
+	void updateAnimations(uint64_t now_us_);
+
+	/// for SyncMode::POLL: stages parameters which have changed since 
+	/// the last frame.
+	void syncParameters();
+	float mMaxAcceleration = 4.f;
+	BankLayout mBankLayout = BankLayout::PAGES;
+
+	/// binds a device's encoders to the page it follows, according to 
+	/// the bank layout.
+	void bindDevice(Device& d_);
+
+	/// binds only the encoders of bank_ - to the page this bank shows.
+	void bindBank(Device& d_, size_t bank_);
+
+	// side buttons, if set to send CC, send on the system channel:
+	// 6 buttons per bank, 3 on the left, then 3 on the right.
+	static const uint8_t SIDE_BUTTON_FIRST_CC = 8;
+	static const uint8_t SIDE_BUTTONS_PER_BANK = 6;
+
+	/// fraction of the parameter range 128 relative ticks span on bank_
+	float getTickRange(size_t bank_) const;
+
+	/// applies a message to the encoder it is meant for.
+	void applyMessage(Device& d_, Encoder& e_, const MidiInMessage& m_);
+	void applyAbsolute(Device& d_, Encoder& e_, uint8_t v_);
+	void applyRelative(Device& d_, Encoder& e_, float ticks_);
+
+	Smoothing mSmoothing = Smoothing::NONE;
+	float mSmoothingTime = 0.05f;
+	uint32_t mSmoothingBudget_us = 1000;
+	size_t mSmoothingCursor = 0; ///< where the next step starts, so that a tight budget is shared fairly
+	
+	/// moves all converging parameters one step - within budget.
+	void stepSmoothing(uint64_t now_us_);
+
+	// taken by update(), setParams(), and the setters - and by the 
+	// smoothing worker whilst it steps. recursive, as listeners may
+	// call back into us whilst we hold it.
+	std::recursive_mutex mUpdateMutex;
+
+	std::thread mSmoothingWorker;
+	std::atomic<bool> mSmoothingWorkerShouldRun{ false };
+
+	// statistics - only touched by the thread calling update()
+	void recordLatency(uint64_t received_us_, uint64_t now_us_);
+	void updateRates(uint64_t now_us_);
+
+	LatencyHistogram mLatencyHistogram;
+	uint64_t mMessagesIn = 0;
+	uint64_t mMessagesOutBase = 0;	///< sent count, over all devices, at last resetStats()
+	
+	uint64_t mRateWindowStart_us = 0;
+	uint64_t mRateWindowIn = 0;		///< mMessagesIn at start of rate window
+	uint64_t mRateWindowOut = 0;	///< sent count at start of rate window
+	float mRateIn = 0.f;
+	float mRateOut = 0.f;
+
+	uint64_t getSentCount() const; ///< total over all devices
 
 };
 